@@ -0,0 +1,239 @@
+/*
+    Usage: bench_prune ENGINE K L N [-g] [-r#] < corpus
+
+    Time a single prune engine of gensparseg on a corpus of graphs in graph6
+    format, e.g., the output of gensparseg. The graphs are replayed the way geng
+    builds them: the engine is called on the subgraphs induced by the first
+    1, 2, ..., n vertices of every graph, skipping the ones shared with the
+    previous graph, and the rest of a graph is skipped once one of its
+    subgraphs is rejected. A corpus generated without pruning, e.g.,
+    gensparseg 9 15:15 -d2, therefore also times the rejections.
+    ENGINE is one of pebble, pebblecomp, comb, gray, flow, henneberg1, rigidity
+    and none. For rigidity, K is the dimension.
+    -g times the generic engine even if there is an instance of it for K, L,
+        and N, see prunekernel.h.
+    -r# replays the corpus this many times and reports the fastest (default 3).
+
+    Prints tab-separated lines with the engine, the number of vertices, the
+    number of graphs, the number of calls, the number of rejected calls, and
+    the CPU time in seconds of the fastest replay, first for all calls with
+    "all" as the number of vertices and then for the calls on each number of
+    vertices. The time of each number of vertices is the share of its ticks,
+    see pruneticks, of the total time.
+*/
+
+#include <time.h>
+#include "gtools.h"
+#include "prunesparse.h"
+
+typedef struct
+{
+    const char *name;
+    int (*prune)(graph *, int, int);
+} engine;
+
+/* Calls to prune on one number of vertices during a replay. */
+typedef struct
+{
+    unsigned long long calls, rejected, ticks;
+} depthcounts;
+
+static const engine engines[] = {
+    {"pebble", prunetightpebble},
+    {"pebblecomp", prunetightpebblecomp},
+    {"comb", prunetightcomb},
+    {"gray", prunetightgray},
+    {"flow", prunetightflow},
+    {"henneberg1", prunehenneberg1},
+    {"rigidity", prunerigidity},
+    {"none", nopruning},
+};
+
+/* Replay the corpus of graphs on maxn vertices once, see the usage above, and
+ * count the calls on n vertices in counts[n]. */
+void replay(int (*prune)(graph *, int, int), graph *corpus, size_t graphs, int maxn, depthcounts *counts)
+{
+    int i, n, depth, rejected;
+    size_t k;
+    graph h[MAXN];
+    graph *g, *previous;
+    setword nb;
+    unsigned long long start;
+
+    memset(counts, 0, (maxn + 1) * sizeof(*counts));
+    depth = 0;
+    previous = NULL;
+    for (k = 0; k < graphs; ++k)
+    {
+        g = corpus + k * maxn;
+
+        /* the subgraph accepted for the previous graph that is shared */
+        n = 0;
+        if (previous)
+            while (n < depth && (g[n] & ALLMASK(n)) == (previous[n] & ALLMASK(n)))
+                ++n;
+        for (i = 0; i < n; ++i)
+            h[i] = g[i] & ALLMASK(n);
+
+        /* add the remaining vertices one at a time like geng */
+        depth = n;
+        for (n = depth + 1; n <= maxn; ++n)
+        {
+            nb = g[n - 1] & ALLMASK(n - 1);
+            h[n - 1] = nb;
+            while (nb)
+            {
+                i = FIRSTBITNZ(nb);
+                nb &= ~NTH_NODE(i);
+                h[i] |= NTH_NODE(n - 1);
+            }
+
+            start = pruneticks();
+            rejected = (*prune)(h, n, maxn);
+            counts[n].ticks += pruneticks() - start;
+            counts[n].calls++;
+            if (rejected)
+            {
+                counts[n].rejected++;
+                break;
+            }
+            depth = n;
+        }
+        previous = g;
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    int i, e, n, maxn, repetitions;
+    long kn, kd, ln, ld;
+    size_t graphs, capacity;
+    graph *corpus;
+    char line[4096];
+    clock_t start;
+    double seconds, best;
+    unsigned long long calls, rejected, ticks;
+    depthcounts counts[MAXN + 1], fastest[MAXN + 1];
+    boolean generic;
+    int (*engineprune)(graph *, int, int);
+
+    if (argc >= 2 && strcmp(argv[1], "-h") == 0)
+    {
+        printf("Usage: bench_prune ENGINE K L N [-g] [-r#] < corpus\n");
+        return 0;
+    }
+
+    if (argc < 5)
+        gt_abort(">E bench_prune: ENGINE, K, L, and N are mandatory arguments\n");
+    for (e = 0; e < (int)(sizeof(engines) / sizeof(engines[0])); ++e)
+        if (strcmp(argv[1], engines[e].name) == 0)
+            break;
+    if (e == sizeof(engines) / sizeof(engines[0]))
+        gt_abort(">E bench_prune: unknown engine\n");
+    if (!parserational(argv[2], &kn, &kd))
+        gt_abort(">E bench_prune: K has to be a number\n");
+    if (!parserational(argv[3], &ln, &ld))
+        gt_abort(">E bench_prune: L has to be a number\n");
+    minn = atoi(argv[4]);
+    if (kn <= 0)
+        gt_abort(">E bench_prune: K has to be positive\n");
+    if (minn < 1)
+        gt_abort(">E bench_prune: N has to be a positive integer\n");
+#ifdef INT_KL
+    if (kd != 1 || ld != 1)
+        gt_abort(">E bench_prune: K and L have to be integers when compiled with INT_KL\n");
+#endif
+    tightkn = kn;
+    tightkd = kd;
+    tightln = ln;
+    tightld = ld;
+
+    repetitions = 3;
+    generic = FALSE;
+    for (i = 5; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-g") == 0)
+            generic = TRUE;
+        else if (strncmp(argv[i], "-r", 2) != 0 || (repetitions = atoi(argv[i] + 2)) < 1)
+            gt_abort(">E bench_prune: unknown argument\n");
+    }
+
+    /* read the whole corpus first so that only the engine is timed */
+    maxn = 0;
+    graphs = 0;
+    capacity = 0;
+    corpus = NULL;
+    while (fgets(line, sizeof(line), stdin))
+    {
+        n = graphsize(line);
+        if (graphs == 0)
+            maxn = n;
+        if (n != maxn || n < 1 || n > MAXN)
+            gt_abort(">E bench_prune: the graphs of the corpus need the same number of vertices\n");
+        if (graphs == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 1024;
+            corpus = realloc(corpus, capacity * maxn * sizeof(graph));
+            if (!corpus)
+                gt_abort(">E bench_prune: not enough memory\n");
+        }
+        stringtograph(line, corpus + graphs * maxn, 1);
+        graphs++;
+    }
+
+    scalekl();
+    if (engines[e].prune == prunetightpebble || engines[e].prune == prunetightpebblecomp)
+    {
+        if (!setuppebblegame())
+            gt_abort(">E bench_prune: the pebble game cannot be used for this K, L, and N\n");
+    }
+    else if (engines[e].prune == prunehenneberg1 || engines[e].prune == prunerigidity)
+    {
+        if (tightkd != 1 || tightld != 1)
+            gt_abort(">E bench_prune: K and L have to be integers for this engine\n");
+        rigiddim = tightkn;
+        if (engines[e].prune == prunerigidity && maxn > 0)
+            setuprigidity(maxn);
+    }
+
+    /* the instance PLUGIN_INIT would use */
+    engineprune = engines[e].prune;
+    if (!generic)
+        selectkernel();
+    if (engineprune == prunetightpebble)
+        engineprune = kernel->pebble;
+    else if (engineprune == prunetightpebblecomp)
+        engineprune = kernel->pebblecomp;
+    else if (engineprune == prunetightcomb)
+        engineprune = kernel->comb;
+    else if (engineprune == prunetightgray)
+        engineprune = kernel->gray;
+
+    best = 0;
+    for (i = 0; i < repetitions; ++i)
+    {
+        start = clock();
+        replay(engineprune, corpus, graphs, maxn, counts);
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (i == 0 || seconds < best)
+        {
+            best = seconds;
+            memcpy(fastest, counts, sizeof(counts));
+        }
+    }
+
+    calls = rejected = ticks = 0;
+    for (n = 1; n <= maxn; ++n)
+    {
+        calls += fastest[n].calls;
+        rejected += fastest[n].rejected;
+        ticks += fastest[n].ticks;
+    }
+    printf("%s\tall\t%zu\t%llu\t%llu\t%.4f\n", engines[e].name, graphs, calls, rejected, best);
+    for (n = 1; n <= maxn; ++n)
+        if (fastest[n].calls)
+            printf("%s\t%d\t%zu\t%llu\t%llu\t%.4f\n", engines[e].name, n, graphs, fastest[n].calls,
+                   fastest[n].rejected, ticks ? best * fastest[n].ticks / ticks : 0);
+    free(corpus);
+    return 0;
+}
@@ -37,11 +37,21 @@
             >Z 1 graphs passed rank filter in 710.35 sec
 */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
 #include <exception>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
 #include <string>
-#include <ctime>
+#include <thread>
 #include <vector>
+#include "graph6.h"
 #include "Eigen/Dense"
 #include "Eigen/SVD"
 #include "Eigen/QR"
@@ -50,7 +60,7 @@ using namespace std;
 using namespace Eigen;
 
 const string help_text =
-    "Usage: filter_rank [dim [dof [trials]]] [-cpu]\n\n"
+    "Usage: filter_rank [dim [dof [trials]]] [-cepsu] [-j#]\n\n"
     "Filter graphs based on the rank of the rigidity matrix for random realizations.\n"
     "With the default arguments, the filter will keep all rigid graphs in 3D.\n\n"
     "    dim     : the dimension of the space (default 3).\n"
@@ -62,8 +72,23 @@ const string help_text =
     "              is used to determine whether or not a graph passed the filter.\n"
     "    -c      : inverts the filter and returns the graphs that do not have the\n"
     "              desired rank. If dof=0, this will result in all flexible graphs.\n"
+    "    -e      : computes the rank exactly modulo the prime 2^61-1 for random\n"
+    "              integer realizations instead of numerically. A rank that is\n"
+    "              too low is reported with probability at most dim*n/2^61 per\n"
+    "              realization, so one trial is enough. Consecutive graphs of the\n"
+    "              same size are first checked 8 at a time modulo a prime below\n"
+    "              2^26, which is exact when the rank is full. Other graphs are\n"
+    "              checked again by adding the edges one at a time, stopping as\n"
+    "              soon as the result is known unless -p is given.\n"
     "    -p      : outputs the excessive degrees of freedom along with the graphs.\n"
-    "    -u      : suppresses the output and only counts the graphs.";
+    "    -s      : outputs a histogram of the excessive degrees of freedom of all\n"
+    "              graphs instead of the graphs, one \"dof <dof> <count>\" line per\n"
+    "              value. With several trials, the value found by most of them is\n"
+    "              used. Histograms of several runs can be summed using\n"
+    "              merge_statistics.\n"
+    "    -u      : suppresses the output and only counts the graphs.\n"
+    "    -j#     : the number of threads to use (default 1). The output is in the\n"
+    "              same order as the input.";
 
 struct Edge
 {
@@ -81,63 +106,641 @@ struct Graph
     Graph(int n) : n(n), edge_list(){};
 };
 
-// See http://users.cecs.anu.edu.au/~bdm/data/formats.txt
-Graph parse_graph6(string graph6)
+// The edge list of g is reused to avoid allocating memory for every graph.
+void parse_graph6(const char *graph6, size_t length, Graph &g)
 {
-    if (graph6.empty())
-        throw std::invalid_argument("Empty string is not a valid graph6 graph.");
-    if (graph6[0] == 126)
-        throw std::invalid_argument("Support for graphs with more than 62 vertices is not implemented.");
+    uint64_t lower[G6MAXN];
+    int n = g6decode(graph6, length, lower);
+    if (n < 0)
+        throw std::invalid_argument("Not a graph6 graph with at most 62 vertices.");
 
-    int n = graph6[0] - 63;
-    Graph g(n);
-
-    int bit_index = -1;
-    int char_index = 1;
-    int data = 0;
+    g.n = n;
+    g.edge_list.clear();
     for (int j = 1; j < n; j++)
     {
-        for (int i = 0; i < j; i++)
+        // Edge (i,j) exists for every bit in lower[j], with i = 0 in the highest bit.
+        for (uint64_t nb = lower[j]; nb != 0;)
+        {
+            int i = __builtin_clzll(nb);
+            nb ^= (uint64_t(1) << 63) >> i;
+            g.edge_list.emplace_back(i, j);
+        }
+    }
+}
+
+// Random realizations, the rigidity matrix and its decomposition, kept by each
+// thread. Eigen only reallocates when the size of a matrix changes, so there
+// are no allocations per graph as long as n and m stay the same, which is the
+// case for the tight graphs from gensparseg.
+struct Workspace
+{
+    mt19937_64 rng;
+    uniform_real_distribution<double> uniform;
+    MatrixXd p;
+    MatrixXd R;
+    ColPivHouseholderQR<MatrixXd> decomp;
+    vector<uint64_t> p_mod;
+    vector<uint64_t> R_mod;
+    vector<int> pivots;
+    vector<int> degree;
+    vector<int> order;
+    vector<double> p_lanes;
+    vector<double> R_lanes;
+    vector<Graph> graphs;
+    vector<int> ranks;
+
+    Workspace() : rng(), uniform(-1.0, 1.0), p(), R(), decomp(), p_mod(), R_mod(), pivots(), degree(), order(),
+                  p_lanes(), R_lanes(), graphs(), ranks(){};
+};
+
+// The dimension is a compile time constant for Dim != Dynamic, which lets Eigen
+// use fixed size blocks for the rows of the rigidity matrix.
+template <int Dim>
+int rigidity_rank(const Graph &g, int dim, Workspace &ws)
+{
+    int n = g.n;
+    int m = g.edge_list.size();
+
+    ws.p.resize(dim, n);
+    for (int i = 0; i < dim * n; i++)
+        ws.p(i) = ws.uniform(ws.rng);
+    ws.R.setZero(m, dim * n);
+
+    for (int i = 0; i < m; i++)
+    {
+        const Edge &e = g.edge_list[i];
+        auto ps = ws.p.template block<Dim, 1>(0, e.s, dim, 1);
+        auto pd = ws.p.template block<Dim, 1>(0, e.d, dim, 1);
+        ws.R.template block<1, Dim>(i, dim * e.s, 1, dim) = (ps - pd).transpose();
+        ws.R.template block<1, Dim>(i, dim * e.d, 1, dim) = (pd - ps).transpose();
+    }
+
+    ws.decomp.compute(ws.R);
+    return ws.decomp.rank();
+}
+
+int rigidity_rank(const Graph &g, int dim, Workspace &ws)
+{
+    switch (dim)
+    {
+    case 1:
+        return rigidity_rank<1>(g, dim, ws);
+    case 2:
+        return rigidity_rank<2>(g, dim, ws);
+    case 3:
+        return rigidity_rank<3>(g, dim, ws);
+    default:
+        return rigidity_rank<Dynamic>(g, dim, ws);
+    }
+}
+
+// Arithmetic modulo the Mersenne prime 2^61-1. The product of two residues fits
+// in 122 bits and is reduced by adding its high and low 61 bits.
+const uint64_t prime = (uint64_t(1) << 61) - 1;
+
+inline uint64_t mul_mod(uint64_t a, uint64_t b)
+{
+    unsigned __int128 z = (unsigned __int128)a * b;
+    uint64_t r = ((uint64_t)z & prime) + (uint64_t)(z >> 61);
+    return r >= prime ? r - prime : r;
+}
+
+inline uint64_t sub_mod(uint64_t a, uint64_t b)
+{
+    return a >= b ? a - b : a + prime - b;
+}
+
+uint64_t inv_mod(uint64_t a)
+{
+    // Fermat's little theorem: a^(p-2) = a^-1.
+    uint64_t result = 1;
+    for (uint64_t e = prime - 2; e; e >>= 1)
+    {
+        if (e & 1)
+            result = mul_mod(result, a);
+        a = mul_mod(a, a);
+    }
+    return result;
+}
+
+// The rank of the rigidity matrix over GF(2^61-1) for a random integer
+// realization. Every minor of the rigidity matrix is a polynomial of degree at
+// most dim * n in the coordinates, so by the Schwartz-Zippel lemma the rank is
+// lower than the generic rank with probability at most dim * n / (2^61-1).
+//
+// The rows are inserted one at a time into a basis in echelon form. If target
+// is not negative, the insertion stops as soon as it is known whether the rank
+// equals target, and the returned value is then only guaranteed to differ from
+// target when the rank does. The edges are inserted in decreasing order of the
+// degree sum of their end points, so that the rows of dense subgraphs, where
+// dependencies usually occur, come first.
+int rigidity_rank_exact(const Graph &g, int dim, int target, Workspace &ws)
+{
+    int n = g.n;
+    int m = g.edge_list.size();
+    int cols = dim * n;
+
+    ws.p_mod.resize(cols);
+    for (uint64_t &x : ws.p_mod)
+        x = ws.rng() & prime;
+
+    ws.degree.assign(n, 0);
+    for (const Edge &e : g.edge_list)
+    {
+        ws.degree[e.s]++;
+        ws.degree[e.d]++;
+    }
+    ws.order.resize(m);
+    for (int i = 0; i < m; i++)
+        ws.order[i] = i;
+    stable_sort(ws.order.begin(), ws.order.end(), [&](int a, int b) {
+        const Edge &ea = g.edge_list[a];
+        const Edge &eb = g.edge_list[b];
+        return ws.degree[ea.s] + ws.degree[ea.d] > ws.degree[eb.s] + ws.degree[eb.d];
+    });
+
+    // Rows of the basis, each scaled to one in its pivot column and zero in the
+    // pivot columns of the rows before it, followed by the row being inserted.
+    int max_rank = min(m, cols);
+    ws.R_mod.resize((size_t)(max_rank + 1) * cols);
+    ws.pivots.resize(max_rank);
+
+    int rank = 0;
+    for (int i = 0; i < m; i++)
+    {
+        if (target >= 0 && (rank > target || rank + m - i < target))
+            return rank > target ? rank : rank + m - i;
+
+        const Edge &e = g.edge_list[ws.order[i]];
+        uint64_t *row = &ws.R_mod[(size_t)rank * cols];
+        fill(row, row + cols, 0);
+        for (int j = 0; j < dim; j++)
+        {
+            uint64_t v = sub_mod(ws.p_mod[dim * e.s + j], ws.p_mod[dim * e.d + j]);
+            row[dim * e.s + j] = v;
+            row[dim * e.d + j] = sub_mod(0, v);
+        }
+
+        for (int k = 0; k < rank; k++)
+        {
+            int c = ws.pivots[k];
+            uint64_t factor = row[c];
+            if (factor == 0)
+                continue;
+            const uint64_t *brow = &ws.R_mod[(size_t)k * cols];
+            for (int j = c; j < cols; j++)
+                row[j] = sub_mod(row[j], mul_mod(factor, brow[j]));
+        }
+
+        int c = 0;
+        while (c < cols && row[c] == 0)
+            c++;
+        if (c == cols)
+            continue;
+        uint64_t inv = inv_mod(row[c]);
+        for (int j = c; j < cols; j++)
+            row[j] = mul_mod(row[j], inv);
+        ws.pivots[rank++] = c;
+    }
+    return rank;
+}
+
+// Graphs of the same size are checked together, one in each lane of a
+// structure of arrays, by elimination modulo a prime below 2^26. Residues and
+// their products are then exact in doubles, so the loops over the lanes are
+// plain floating-point arithmetic that the compiler vectorizes.
+const int lanes = 8;
+const double lane_prime = 67108859;
+const double lane_inverse = 1.0 / lane_prime;
+
+// Reduces an integer |x| < 2^52. The quotient is rounded to the nearest integer
+// by adding and subtracting 1.5 * 2^52, which unlike floor is vectorized
+// without -fno-trapping-math.
+inline double lane_mod(double x)
+{
+    const double round = 6755399441055744.0;
+    double q = (x * lane_inverse + round) - round;
+    double r = x - q * lane_prime;
+    r = r < 0 ? r + lane_prime : r;
+    return r >= lane_prime ? r - lane_prime : r;
+}
+
+// The ranks of the rigidity matrices of count <= lanes graphs with the same
+// number of vertices and edges over GF(67108859), for random integer
+// realizations. Row k is the pivot row in step k in all lanes, with the first
+// nonzero column in each lane as the pivot column, so that the lanes stay in
+// lockstep. Since the matrices are integer, a full row rank modulo the prime is
+// also the rank over the rationals. Any other rank is only a lower bound.
+void rigidity_rank_lanes(const Graph *graphs, int count, int dim, int *ranks, Workspace &ws)
+{
+    int n = graphs[0].n;
+    int m = graphs[0].edge_list.size();
+    int cols = dim * n;
+    size_t row_size = (size_t)cols * lanes;
+    int pivot[lanes];
+    double factor[lanes];
+    double inverse[lanes];
+    int rank[lanes] = {0};
+
+    ws.p_lanes.resize(row_size);
+    for (double &x : ws.p_lanes)
+        x = ws.rng() % (uint64_t)lane_prime;
+
+    ws.R_lanes.assign((size_t)m * row_size, 0.0);
+    for (int l = 0; l < lanes; l++)
+    {
+        // Unused lanes repeat the last graph.
+        const Graph &g = graphs[min(l, count - 1)];
+        for (int i = 0; i < m; i++)
+        {
+            const Edge &e = g.edge_list[i];
+            double *row = &ws.R_lanes[i * row_size];
+            for (int j = 0; j < dim; j++)
+            {
+                double v = lane_mod(ws.p_lanes[(dim * e.s + j) * lanes + l] - ws.p_lanes[(dim * e.d + j) * lanes + l]);
+                row[(dim * e.s + j) * lanes + l] = v;
+                row[(dim * e.d + j) * lanes + l] = lane_mod(-v);
+            }
+        }
+    }
+
+    for (int k = 0; k < m; k++)
+    {
+        double *prow = &ws.R_lanes[k * row_size];
+        for (int l = 0; l < lanes; l++)
+        {
+            int c = 0;
+            while (c < cols && prow[c * lanes + l] == 0)
+                c++;
+            pivot[l] = c < cols ? c : -1;
+            rank[l] += c < cols;
+            inverse[l] = c < cols ? prow[c * lanes + l] : 0;
+        }
+
+        // Fermat's little theorem: a^(p-2) = a^-1. A zero row stays zero.
+        double base[lanes];
+        for (int l = 0; l < lanes; l++)
+        {
+            base[l] = inverse[l];
+            inverse[l] = 1;
+        }
+        for (uint64_t e = (uint64_t)lane_prime - 2; e; e >>= 1)
         {
-            if (bit_index < 0)
+            for (int l = 0; l < lanes; l++)
             {
-                // No bounds check on graph6. We assume correctly formatted string.
-                data = graph6[char_index] - 63;
-                char_index++;
-                bit_index = 5;
+                if (e & 1)
+                    inverse[l] = lane_mod(inverse[l] * base[l]);
+                base[l] = lane_mod(base[l] * base[l]);
             }
-            if (data & (1 << bit_index))
+        }
+        for (int c = 0; c < cols; c++)
+            for (int l = 0; l < lanes; l++)
+                prow[c * lanes + l] = lane_mod(prow[c * lanes + l] * inverse[l]);
+
+        for (int i = k + 1; i < m; i++)
+        {
+            double *row = &ws.R_lanes[i * row_size];
+            bool any = false;
+            for (int l = 0; l < lanes; l++)
             {
-                // Edge (i,j) exists.
-                g.edge_list.emplace_back(i, j);
+                factor[l] = pivot[l] >= 0 ? row[pivot[l] * lanes + l] : 0;
+                any |= factor[l] != 0;
             }
-            bit_index--;
+            if (!any)
+                continue;
+            for (int c = 0; c < cols; c++)
+                for (int l = 0; l < lanes; l++)
+                    row[c * lanes + l] = lane_mod(row[c * lanes + l] - factor[l] * prow[c * lanes + l]);
         }
     }
 
-    return g;
+    for (int l = 0; l < count; l++)
+        ranks[l] = rank[l];
 }
 
-int rigidity_rank(const Graph &g, int dim)
+struct Options
 {
-    int n = g.n;
-    int m = g.edge_list.size();
+    int dim;
+    int dof;
+    int trials;
+    bool complement;
+    bool exact;
+    bool print_dof;
+    bool statistics;
+    bool nooutput;
+};
+
+// Consecutive input lines handled by one thread at a time. The random
+// realizations only depend on the index of the batch, so the result does not
+// depend on the number of threads. The lines are kept in one string, which is
+// reused together with the output when the batch is recycled.
+struct Batch
+{
+    size_t index;
+    string text;
+    vector<size_t> ends;
+    string output;
+    string messages;
+    unsigned long long count;
+    map<int, unsigned long long> dofs;
 
-    MatrixXd p = MatrixXd::Random(dim, n);
-    MatrixXd R = MatrixXd::Zero(m, dim * n);
+    Batch() : index(0), text(), ends(), output(), messages(), count(0), dofs(){};
 
-    for (int i = 0; i < m; i++)
+    void clear(size_t i)
     {
-        Edge e = g.edge_list[i];
-        VectorXd v = p.col(e.s) - p.col(e.d);
-        R.block<1, Dynamic>(i, dim * e.s, 1, dim) = v;
-        R.block<1, Dynamic>(i, dim * e.d, 1, dim) = -v;
+        index = i;
+        text.clear();
+        ends.clear();
+        output.clear();
+        messages.clear();
+        count = 0;
+        dofs.clear();
     }
+};
 
-    ColPivHouseholderQR<MatrixXd> decomp(R);
-    return decomp.rank();
+const size_t batch_size = 256;
+
+void append_int(string &s, int i)
+{
+    char buffer[16];
+    int length = snprintf(buffer, sizeof(buffer), "%d", i);
+    s.append(buffer, length);
 }
 
+// The ranks of all graphs of the batch for one realization each, stored in
+// ws.ranks[k * trials + trial].
+void batch_ranks(size_t count, int trial, const Options &opt, Workspace &ws)
+{
+    int gauge_freedom = opt.dim * (opt.dim + 1) / 2;
+    bool full_rank = opt.print_dof || opt.statistics;
+    int lane_ranks[lanes];
+
+    for (size_t k = 0; k < count;)
+    {
+        const Graph &g = ws.graphs[k];
+        if (!opt.exact)
+        {
+            ws.ranks[k++ * opt.trials + trial] = rigidity_rank(g, opt.dim, ws);
+            continue;
+        }
+
+        // Consecutive graphs of the same size share the lanes.
+        size_t end = k + 1;
+        while (end < count && end - k < (size_t)lanes && ws.graphs[end].n == g.n &&
+               ws.graphs[end].edge_list.size() == g.edge_list.size())
+            end++;
+        if (end - k > 1)
+            rigidity_rank_lanes(&ws.graphs[k], end - k, opt.dim, lane_ranks, ws);
+
+        for (size_t j = k; j < end; j++)
+        {
+            int m = ws.graphs[j].edge_list.size();
+            int target = opt.dim * ws.graphs[j].n - gauge_freedom - opt.dof;
+            int rank = end - k > 1 ? lane_ranks[j - k] : -1;
+            // A full row rank is exact and a rank above target is enough to
+            // reject the graph. Otherwise the rank modulo the small prime may
+            // be too low by chance, so the graph is checked again.
+            if (rank != m && (full_rank || rank <= target))
+                rank = rigidity_rank_exact(ws.graphs[j], opt.dim, full_rank ? -1 : target, ws);
+            ws.ranks[j * opt.trials + trial] = rank;
+        }
+        k = end;
+    }
+}
+
+void filter_batch(Batch &batch, const Options &opt, Workspace &ws)
+{
+    int gauge_freedom = opt.dim * (opt.dim + 1) / 2;
+    size_t count = batch.ends.size();
+
+    ws.rng.seed(batch.index);
+    if (ws.graphs.size() < count)
+        ws.graphs.resize(count, Graph(0));
+    size_t begin = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        parse_graph6(batch.text.data() + begin, batch.ends[k] - begin, ws.graphs[k]);
+        begin = batch.ends[k] + 1;
+    }
+
+    ws.ranks.resize(count * opt.trials);
+    for (int i = 0; i < opt.trials; i++)
+        batch_ranks(count, i, opt, ws);
+
+    begin = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        const char *graph6 = batch.text.data() + begin;
+        size_t length = batch.ends[k] - begin;
+        begin = batch.ends[k] + 1;
+
+        int rigid_rank = opt.dim * ws.graphs[k].n - gauge_freedom;
+        int passes = 0;
+        for (int i = 0; i < opt.trials; i++)
+        {
+            int edof = rigid_rank - ws.ranks[k * opt.trials + i];
+            if ((edof == opt.dof) != opt.complement)
+                passes++;
+        }
+        // Warn if majority voting was necessary. If this happens often trials might need to be increased.
+        if (passes != 0 && passes != opt.trials)
+        {
+            batch.messages += ">Z majority voting was required ";
+            append_int(batch.messages, passes);
+            batch.messages += '/';
+            append_int(batch.messages, opt.trials);
+            batch.messages += '\n';
+        }
+        if (opt.statistics)
+        {
+            // The value found by most realizations, the smallest one on a tie.
+            int mode = 0;
+            int votes = 0;
+            for (int i = 0; i < opt.trials; i++)
+            {
+                int edof = rigid_rank - ws.ranks[k * opt.trials + i];
+                int c = 0;
+                for (int j = 0; j < opt.trials; j++)
+                    c += rigid_rank - ws.ranks[k * opt.trials + j] == edof;
+                if (c > votes || (c == votes && edof < mode))
+                {
+                    mode = edof;
+                    votes = c;
+                }
+            }
+            batch.dofs[mode]++;
+        }
+        if (passes > opt.trials / 2)
+        {
+            batch.count++;
+            if (!opt.nooutput)
+            {
+                batch.output.append(graph6, length);
+                if (opt.print_dof)
+                {
+                    for (int i = 0; i < opt.trials; i++)
+                    {
+                        batch.output += ' ';
+                        append_int(batch.output, rigid_rank - ws.ranks[k * opt.trials + i]);
+                    }
+                }
+                batch.output += '\n';
+            }
+        }
+    }
+}
+
+// Splits stdin into batches of lines, see graph6.h. The lines are copied into
+// the batch since the buffer of the reader is reused while the batch is queued.
+class BatchReader
+{
+public:
+    BatchReader() : index(0)
+    {
+        if (g6open(&reader, 0) != 0)
+            throw std::bad_alloc();
+    }
+
+    ~BatchReader()
+    {
+        g6close(&reader);
+    }
+
+    bool next(Batch &batch)
+    {
+        const char *line;
+        size_t length;
+
+        batch.clear(index++);
+        while (batch.ends.size() < batch_size && (line = g6line(&reader, &length)) != nullptr)
+        {
+            batch.text.append(line, length);
+            batch.ends.push_back(batch.text.size());
+            batch.text += '\n';
+        }
+        return !batch.ends.empty();
+    }
+
+private:
+    g6reader reader;
+    size_t index;
+};
+
+// Worker threads take batches from a queue and hand them back for output in
+// input order. At most a few batches per thread are in flight at a time.
+class Pipeline
+{
+public:
+    Pipeline(const Options &opt, int jobs) : opt(opt), jobs(jobs), next_index(0), in_flight(0), closed(false), count(0)
+    {
+        for (int i = 0; i < jobs; i++)
+            threads.emplace_back(&Pipeline::work, this);
+    }
+
+    void push(Batch &&batch)
+    {
+        unique_lock<mutex> lock(m);
+        while (in_flight >= 4 * (size_t)jobs)
+        {
+            write_ready(lock);
+            if (in_flight >= 4 * (size_t)jobs)
+                finished.wait(lock);
+        }
+        in_flight++;
+        queue.push_back(move(batch));
+        available.notify_one();
+    }
+
+    // Returns an empty batch, reusing the memory of a written batch if possible.
+    Batch take()
+    {
+        unique_lock<mutex> lock(m);
+        if (spare.empty())
+            return Batch();
+        Batch batch = move(spare.back());
+        spare.pop_back();
+        return batch;
+    }
+
+    unsigned long long finish()
+    {
+        {
+            unique_lock<mutex> lock(m);
+            closed = true;
+            available.notify_all();
+        }
+        for (thread &t : threads)
+            t.join();
+        unique_lock<mutex> lock(m);
+        write_ready(lock);
+        return count;
+    }
+
+    // The histogram of -s over the batches written so far.
+    const map<int, unsigned long long> &dofs() const
+    {
+        return dof_histogram;
+    }
+
+private:
+    const Options &opt;
+    int jobs;
+    vector<thread> threads;
+    mutex m;
+    condition_variable available;
+    condition_variable finished;
+    deque<Batch> queue;
+    map<size_t, Batch> done;
+    vector<Batch> spare;
+    size_t next_index;
+    size_t in_flight;
+    bool closed;
+    unsigned long long count;
+    map<int, unsigned long long> dof_histogram;
+
+    void work()
+    {
+        Workspace ws;
+        unique_lock<mutex> lock(m);
+        for (;;)
+        {
+            while (queue.empty() && !closed)
+                available.wait(lock);
+            if (queue.empty())
+                return;
+            Batch batch = move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            filter_batch(batch, opt, ws);
+            lock.lock();
+            done.emplace(batch.index, move(batch));
+            finished.notify_one();
+        }
+    }
+
+    // Write the finished batches that are next in input order.
+    void write_ready(unique_lock<mutex> &lock)
+    {
+        auto it = done.find(next_index);
+        while (it != done.end())
+        {
+            Batch batch = move(it->second);
+            done.erase(it);
+            in_flight--;
+            next_index++;
+            lock.unlock();
+            cerr << batch.messages;
+            cout << batch.output;
+            count += batch.count;
+            for (auto &entry : batch.dofs)
+                dof_histogram[entry.first] += entry.second;
+            lock.lock();
+            spare.push_back(move(batch));
+            it = done.find(next_index);
+        }
+    }
+};
+
 bool parse_int(string s, int *i)
 {
     try
@@ -155,7 +758,8 @@ bool parse_int(string s, int *i)
     }
 }
 
-bool parse_arguments(int argc, const char *argv[], vector<int *> pos_args, vector<pair<char, bool *>> flag_args)
+bool parse_arguments(int argc, const char *argv[], vector<int *> pos_args, vector<pair<char, bool *>> flag_args,
+                     vector<pair<char, int *>> int_args)
 {
     int pos = 0;
     for (int i = 1; i < argc; i++)
@@ -170,8 +774,9 @@ bool parse_arguments(int argc, const char *argv[], vector<int *> pos_args, vecto
         if (s[0] != '-')
             return false;
 
-        for (auto ch : s.substr(1))
+        for (size_t j = 1; j < s.size(); j++)
         {
+            char ch = s[j];
             bool found_flag = false;
             for (auto flag : flag_args)
             {
@@ -182,6 +787,18 @@ bool parse_arguments(int argc, const char *argv[], vector<int *> pos_args, vecto
                     break;
                 }
             }
+            for (auto flag : int_args)
+            {
+                if (ch == flag.first)
+                {
+                    // The rest of the argument is the value.
+                    if (!parse_int(s.substr(j + 1), flag.second))
+                        return false;
+                    j = s.size();
+                    found_flag = true;
+                    break;
+                }
+            }
             if (!found_flag)
                 return false;
         }
@@ -195,16 +812,23 @@ int main(int argc, const char *argv[])
     int dof = 0;
     int trials = 1;
     bool complement = false;
+    bool exact = false;
     bool print_dof = false;
+    bool statistics = false;
     bool nooutput = false;
+    int jobs = 1;
 
     vector<int *> pos_args = {&dim, &dof, &trials};
     vector<pair<char, bool *>> flag_args = {
         pair<char, bool *>('c', &complement),
+        pair<char, bool *>('e', &exact),
         pair<char, bool *>('p', &print_dof),
+        pair<char, bool *>('s', &statistics),
         pair<char, bool *>('u', &nooutput)};
+    vector<pair<char, int *>> int_args = {
+        pair<char, int *>('j', &jobs)};
 
-    if (!parse_arguments(argc, argv, pos_args, flag_args))
+    if (!parse_arguments(argc, argv, pos_args, flag_args, int_args))
     {
         cout << help_text << endl;
         return 1;
@@ -224,45 +848,30 @@ int main(int argc, const char *argv[])
         cout << ">E filter_rank: trials has to be positive and odd" << endl;
         return 1;
     }
+    if (jobs < 1)
+    {
+        cout << ">E filter_rank: the number of threads has to be positive" << endl;
+        return 1;
+    }
 
-    int gauge_freedom = dim * (dim + 1) / 2;
-
-    int count = 0;
-    string graph6;
-    clock_t c_start = clock();
-    vector<int> excessive_dof(trials);
-    while (getline(cin, graph6))
+    Options opt = {dim, dof, trials, complement, exact, print_dof, statistics, nooutput || statistics};
+    auto c_start = chrono::steady_clock::now();
+    BatchReader reader;
+    Pipeline pipeline(opt, jobs);
+    Batch batch = pipeline.take();
+    while (reader.next(batch))
     {
-        Graph g = parse_graph6(graph6);
-        int rigid_rank = dim * g.n - gauge_freedom;
-        int passes = 0;
-        for (int i = 0; i < trials; i++)
-        {
-            int edof = rigid_rank - rigidity_rank(g, dim);
-            excessive_dof[i] = edof;
-            if ((edof == dof) != complement)
-                passes++;
-        }
-        // Warn if majority voting was necessary. If this happens often trials might need to be increased.
-        if (passes != 0 && passes != trials)
-            cerr << ">Z majority voting was required " << passes << '/' << trials << endl;
-        if (passes > trials / 2)
-        {
-            count++;
-            if (!nooutput)
-            {
-                cout << graph6;
-                if (print_dof)
-                {
-                    for (int edof : excessive_dof)
-                        cout << ' ' << edof;
-                }
-                cout << '\n';
-            }
-        }
+        pipeline.push(move(batch));
+        batch = pipeline.take();
+    }
+    unsigned long long count = pipeline.finish();
+    if (statistics)
+    {
+        for (auto &entry : pipeline.dofs())
+            cout << "dof " << entry.first << ' ' << entry.second << '\n';
     }
-    clock_t c_end = clock();
-    double time = double(c_end - c_start) / CLOCKS_PER_SEC;
+    auto c_end = chrono::steady_clock::now();
+    double time = chrono::duration<double>(c_end - c_start).count();
     cerr.precision(2);
     cerr << ">Z " << count << " graphs passed rank filter in " << fixed << time << " sec" << endl;
     return 0;
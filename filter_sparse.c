@@ -1,18 +1,59 @@
 /*
-    Usage: filter_sparse K L N [-u]
+    Usage: filter_sparse K L N [-su] [-j#]
 
     Filter graphs to keep the ones that are (K,L)-sparse. A graph is (K,L)-
     sparse if every subgraph with n > N vertices has at most Kn-L edges, and
     (K,L)-tight if it is (K,L)-sparse and has exactly Kn-L edges.
+    K and L can be rational, e.g., 3/2.
+    -s does not use the pebble game. Graphs on fewer than 12 vertices are then
+        checked by going through all of their subgraphs, and larger ones
+        with the blocked subset checks and, from 20 vertices, with flows,
+        see SUBSETMINN and FLOWMINN.
     -u suppresses the output and only counts the sparse graphs.
+    -j# checks the graphs using this many threads. The output is in the same
+        order as the input.
 */
 
+#include <pthread.h>
 #include "gtools.h"
+#include "prunesparse.h"
+#include "graph6.h"
 
-#define NTH_NODE(n) (bit[n])
-#define CTZ(x) __builtin_ctz(x)
+#define BATCHSIZE 4096
+#define BATCHESPERTHREAD 4
 
-boolean is_sparse(graph *g, int n, int K, int L, int N)
+/* Consecutive input lines checked by one thread at a time. The lines are
+ * copied since the buffer of the reader is reused, see graph6.h. */
+typedef struct
+{
+    char *text; /* the lines including their newlines */
+    size_t size;
+    size_t capacity;
+    size_t ends[BATCHSIZE];
+    boolean sparse[BATCHSIZE];
+    int lines;
+    unsigned long long count;
+    boolean done;
+} batch;
+
+static boolean usepebblegame;
+
+/* The slots of the batches are reused in a ring. Batch number b is in slot
+ * b % slots. The main thread reads batches until the ring is full and writes
+ * them in order as the threads finish them. */
+static batch *batches;
+static int slots;
+static unsigned long long batchesread, batchestaken;
+static boolean inputdone;
+static pthread_mutex_t batchlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batchready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batchdone = PTHREAD_COND_INITIALIZER;
+
+/* Check every subgraph of a graph on fewer than SUBSETMINN vertices. We use
+ * the Gray code binary representation of i as a mask for which nodes are
+ * included in the subgraph. This way, in every iteration, we either add or
+ * remove a single node to the previous subgraph. */
+boolean graysparse(graph *g, int n)
 {
     int i, j, sn, sm, degree;
     setword mask;
@@ -20,11 +61,6 @@ boolean is_sparse(graph *g, int n, int K, int L, int N)
     mask = 0;
     sn = 0;
     sm = 0;
-
-    /* Go through all subgraphs verifying sparsity. We use the Gray code binary
-     * representation of i as a mask for which nodes are included in the
-     * subgraph. This way, in every iteration, we either add or remove a single
-     * node to the previous subgraph. */
     for (i = 1; i < (1 << n); ++i)
     {
         j = CTZ(i);
@@ -33,62 +69,281 @@ boolean is_sparse(graph *g, int n, int K, int L, int N)
         sn += mask & NTH_NODE(j) ? 1 : -1;
         sm += mask & NTH_NODE(j) ? degree : -degree;
 
-        if (sn > N && sm > K * sn - L)
+        if (sn > minn && TOO_MANY_EDGES(sn, sm))
             return FALSE;
     }
     return TRUE;
 }
 
-int main(int argc, const char *argv[])
+/* Pick the engine the same way as PLUGIN_INIT, but for whole graphs. */
+boolean is_sparse(graph *g, int n)
+{
+    /* graphs on at most N vertices are sparse, also when kn < l */
+    if (n <= minn)
+        return TRUE;
+    if (usepebblegame)
+        return kernel->pebblegame(g, n, scaledk, scaledl, scaledmult) >= 0;
+    /* polynomial for fixed N, see sparseflowviolation */
+    if (n >= FLOWMINN)
+        return !sparseflowviolation(g, n, 0, 0, scaledmult, scaledk, scaledl, minn);
+    if (n >= SUBSETMINN)
+        return !subsetviolation(g, n, 0, scaledmult, scaledk, scaledl, minn);
+    return graysparse(g, n);
+}
+
+/* Turn the neighbours i < j of every vertex j from g6decode into a graph. */
+void lowertograph(uint64_t *lower, graph *g, int n)
+{
+    int i, j;
+    setword nb;
+
+    for (j = 0; j < n; ++j)
+        g[j] = (setword)(lower[j] >> (64 - WORDSIZE));
+    for (j = 1; j < n; ++j)
+    {
+        nb = g[j];
+        while (nb)
+        {
+            i = FIRSTBITNZ(nb);
+            nb &= ~NTH_NODE(i);
+            g[i] |= NTH_NODE(j);
+        }
+    }
+}
+
+void filterbatch(batch *b)
 {
-    int n, K, L, N, count_total, count_sparse;
+    int i, n;
+    size_t begin;
     graph g[MAXN];
-    char *line;
-    size_t size;
-    boolean nooutput;
+    uint64_t lower[G6MAXN];
+
+    b->count = 0;
+    begin = 0;
+    for (i = 0; i < b->lines; ++i)
+    {
+        n = g6decode(b->text + begin, b->ends[i] - begin - 1, lower);
+        if (n < 0)
+            gt_abort(">E filter_sparse: input is not in graph6 format\n");
+        if (n > MAXN)
+            gt_abort(">E filter_sparse: graph has too many vertices\n");
+
+        lowertograph(lower, g, n);
+        b->sparse[i] = is_sparse(g, n);
+        b->count += b->sparse[i];
+        begin = b->ends[i];
+    }
+}
+
+/* Fill b with the next lines of the input.
+ *
+ * Returns:
+ * the number of lines read
+ */
+int readbatch(g6reader *reader, batch *b)
+{
+    const char *line;
+    size_t length;
+
+    b->size = 0;
+    b->lines = 0;
+    b->done = FALSE;
+    while (b->lines < BATCHSIZE && (line = g6line(reader, &length)) != NULL)
+    {
+        if (b->size + length + 1 > b->capacity)
+        {
+            b->capacity = 2 * (b->size + length + 1);
+            b->text = realloc(b->text, b->capacity);
+            if (!b->text)
+                gt_abort(">E filter_sparse: not enough memory\n");
+        }
+        memcpy(b->text + b->size, line, length);
+        b->size += length;
+        b->text[b->size++] = '\n';
+        b->ends[b->lines++] = b->size;
+    }
+    return b->lines;
+}
+
+void writebatch(batch *b, boolean nooutput)
+{
+    int i;
+    size_t begin;
+
+    if (nooutput)
+        return;
+    begin = 0;
+    for (i = 0; i < b->lines; ++i)
+    {
+        if (b->sparse[i])
+            fwrite(b->text + begin, 1, b->ends[i] - begin, stdout);
+        begin = b->ends[i];
+    }
+}
+
+void *filterthread(void *arg)
+{
+    batch *b;
+
+    pthread_mutex_lock(&batchlock);
+    for (;;)
+    {
+        while (batchestaken == batchesread && !inputdone)
+            pthread_cond_wait(&batchready, &batchlock);
+        if (batchestaken == batchesread)
+            break;
+        b = &batches[batchestaken++ % slots];
+        pthread_mutex_unlock(&batchlock);
+
+        filterbatch(b);
+
+        pthread_mutex_lock(&batchlock);
+        b->done = TRUE;
+        pthread_cond_broadcast(&batchdone);
+    }
+    pthread_mutex_unlock(&batchlock);
+    return NULL;
+}
+
+int main(int argc, const char *argv[])
+{
+    int i, j, threads;
+    long kn, kd, ln, ld;
+    unsigned long long count_total, count_sparse, written;
+    boolean nooutput, subsets;
+    g6reader reader;
+    pthread_t *workers;
+    batch *b;
 
     if (argc >= 2 && strcmp(argv[1], "-h") == 0)
     {
-        printf("Usage: filter_sparse K L N [-u]\n");
+        printf("Usage: filter_sparse K L N [-su] [-j#]\n");
         return 0;
     }
 
     if (argc < 4)
         gt_abort(">E filter_sparse: K, L, and N are mandatory arguments\n");
 
-    K = atoi(argv[1]);
-    L = atoi(argv[2]);
-    N = atoi(argv[3]);
+    if (!parserational(argv[1], &kn, &kd))
+        gt_abort(">E filter_sparse: K has to be a number\n");
+    if (!parserational(argv[2], &ln, &ld))
+        gt_abort(">E filter_sparse: L has to be a number\n");
+    minn = atoi(argv[3]);
 
-    if (K < 1)
-        gt_abort(">E filter_sparse: K has to be a positive integer\n");
-    if (N < 1)
+    if (kn <= 0)
+        gt_abort(">E filter_sparse: K has to be positive\n");
+    if (minn < 1)
         gt_abort(">E filter_sparse: N has to be a positive integer\n");
+#ifdef INT_KL
+    if (kd != 1 || ld != 1)
+        gt_abort(">E filter_sparse: K and L have to be integers when compiled with INT_KL\n");
+#endif
+    tightkn = kn;
+    tightkd = kd;
+    tightln = ln;
+    tightld = ld;
 
-    nooutput = argc >= 5 && strcmp(argv[4], "-u") == 0;
+    nooutput = FALSE;
+    subsets = FALSE;
+    threads = 1;
+    for (i = 4; i < argc; ++i)
+    {
+        if (argv[i][0] != '-')
+            gt_abort(">E filter_sparse: unknown argument\n");
+        for (j = 1; argv[i][j] != '\0'; ++j)
+        {
+            if (argv[i][j] == 'u')
+                nooutput = TRUE;
+            else if (argv[i][j] == 's')
+                subsets = TRUE;
+            else if (argv[i][j] == 'j')
+            {
+                threads = atoi(argv[i] + j + 1);
+                if (threads < 1)
+                    gt_abort(">E filter_sparse: -j has to be at least 1\n");
+                break;
+            }
+            else
+                gt_abort(">E filter_sparse: unknown argument\n");
+        }
+    }
+
+    /* see setuppebblegame, which also scales (K,L) */
+    usepebblegame = setuppebblegame() && !subsets;
+    selectkernel();
+
+    if (g6open(&reader, 0) != 0)
+        gt_abort(">E filter_sparse: not enough memory\n");
+
+    slots = threads * BATCHESPERTHREAD;
+    batches = calloc(slots, sizeof(batch));
+    workers = malloc(threads * sizeof(pthread_t));
+    if (!batches || !workers)
+        gt_abort(">E filter_sparse: not enough memory\n");
 
     count_total = 0;
     count_sparse = 0;
-
-    while (getline(&line, &size, stdin) != -1)
+    if (threads == 1)
     {
-        n = graphsize(line);
-        if (n > MAXN)
-            gt_abort(">E filter_sparse: graph has too many vertices\n");
-
-        stringtograph(line, g, 1); // Row of adjacency matrix fits in one word.
+        while (readbatch(&reader, &batches[0]) > 0)
+        {
+            filterbatch(&batches[0]);
+            writebatch(&batches[0], nooutput);
+            count_total += batches[0].lines;
+            count_sparse += batches[0].count;
+        }
+    }
+    else
+    {
+        for (i = 0; i < threads; ++i)
+            if (pthread_create(&workers[i], NULL, filterthread, NULL) != 0)
+                gt_abort(">E filter_sparse: could not start thread\n");
 
-        if (is_sparse(g, n, K, L, N))
+        written = 0;
+        for (;;)
         {
-            if (!nooutput)
-                printf("%s", line);
-            count_sparse++;
+            /* read while there is a free slot, otherwise write the oldest batch */
+            if (!inputdone && batchesread - written < slots)
+            {
+                b = &batches[batchesread % slots];
+                if (readbatch(&reader, b) > 0)
+                {
+                    pthread_mutex_lock(&batchlock);
+                    batchesread++;
+                    pthread_cond_signal(&batchready);
+                    pthread_mutex_unlock(&batchlock);
+                    continue;
+                }
+                pthread_mutex_lock(&batchlock);
+                inputdone = TRUE;
+                pthread_cond_broadcast(&batchready);
+                pthread_mutex_unlock(&batchlock);
+            }
+            if (written == batchesread)
+                break;
+
+            b = &batches[written % slots];
+            pthread_mutex_lock(&batchlock);
+            while (!b->done)
+                pthread_cond_wait(&batchdone, &batchlock);
+            pthread_mutex_unlock(&batchlock);
+            writebatch(b, nooutput);
+            count_total += b->lines;
+            count_sparse += b->count;
+            written++;
         }
 
-        count_total++;
+        for (i = 0; i < threads; ++i)
+            pthread_join(workers[i], NULL);
     }
+    g6close(&reader);
 
-    fprintf(stderr, ">Z %d/%d graphs were sparse (K,L,N) = (%d,%d,%d)\n", count_sparse, count_total, K, L, N);
+    if (tightkd == 1 && tightld == 1)
+        fprintf(stderr, ">Z %llu/%llu graphs were sparse (K,L,N) = (%ld,%ld,%d)\n",
+                count_sparse, count_total, (long)tightkn, (long)tightln, minn);
+    else
+        fprintf(stderr, ">Z %llu/%llu graphs were sparse (K,L,N) = (%ld/%ld,%ld/%ld,%d)\n",
+                count_sparse, count_total, (long)tightkn, (long)tightkd, (long)tightln, (long)tightld, minn);
 
     return 0;
 }
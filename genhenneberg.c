@@ -0,0 +1,382 @@
+/*
+    Usage: genhenneberg [-2uq] n [res/mod]
+
+    Generate the graphs on n vertices constructible from a single edge by
+    Henneberg type I moves, i.e., adding a vertex joined to two vertices, one
+    of each isomorphism class. The output is in graph6 format.
+    -2 also allows Henneberg type II moves, i.e., removing an edge (a,b) and
+        adding a vertex joined to a, b and a third vertex, which generates all
+        Laman graphs.
+    -u suppresses the output and only counts the graphs.
+    -q suppresses the messages on stderr.
+    res/mod only generates part res of mod parts of the graphs. Running
+        0/mod, 1/mod, ..., mod-1/mod generates every graph exactly once.
+
+    Instead of generating all (2,3)-sparse graphs and pruning the ones that are
+    not constructible like gensparseg -H, the graphs are built by the moves
+    themselves using canonical construction paths, see McKay (1998) Isomorph-
+    free exhaustive generation. Every graph G on more than two vertices has a
+    canonical reduction: its last vertex in the canonical labelling by nauty
+    among the vertices of degree two, or, if there are none and -2 is given,
+    among the vertices of degree three, which are removed together with adding
+    an edge between two of their neighbours. A child G of a parent P is
+    accepted only if the new vertex is equivalent to the canonical reduction of
+    G under the automorphisms of G, so that every graph has a single parent up
+    to isomorphism, and the children of one parent that are accepted more than
+    once are discarded by their canonical labelling.
+
+    Removing a vertex of degree two from a graph constructible by type I moves
+    leaves a constructible graph, since these are exactly the 2-degenerate
+    graphs with 2n-3 edges, see prunehenneberg1. With -2, every Laman graph
+    has a vertex of degree two or three, and a vertex of degree three can be
+    reduced by adding at least one edge between its neighbours, see Laman
+    (1970) On graphs and rigidity of plane skeletal structures.
+*/
+
+#include "gtools.h"
+#include "prunesparse.h"
+
+/* Levels below this many vertices are not split with res/mod. */
+#define SPLITMINN 5
+
+/* The canonical labellings of the children of a parent accepted so far, in an
+ * open addressing table of rows of the canonical graphs. A row of zeros marks
+ * an empty slot since the graphs have no isolated vertices. */
+typedef struct
+{
+    graph *rows;
+    size_t count, slots;
+} childset;
+
+static childset children[MAXN + 1];
+static int maxn, splitlevel, res, mod;
+static boolean typeii, nooutput;
+static unsigned long long splitcount, nout;
+
+/* Insert the canonical graph h on n vertices into the set of level n.
+ *
+ * Returns:
+ * FALSE if it was already in the set
+ */
+boolean insertchild(childset *set, graph *h, int n)
+{
+    int i;
+    size_t slot, oldslots;
+    unsigned long long hash;
+    graph *old;
+
+    if (2 * (set->count + 1) > set->slots)
+    {
+        old = set->rows;
+        oldslots = set->slots;
+        set->slots = oldslots ? 2 * oldslots : 64;
+        set->rows = calloc(set->slots * n, sizeof(graph));
+        if (!set->rows)
+            gt_abort(">E genhenneberg: not enough memory\n");
+        set->count = 0;
+        for (slot = 0; slot < oldslots; ++slot)
+            if (old[slot * n] != 0)
+                insertchild(set, old + slot * n, n);
+        free(old);
+    }
+
+    /* FNV-1a, see addsequence */
+    hash = 14695981039346656037ULL;
+    for (i = 0; i < n; ++i)
+        hash = (hash ^ h[i]) * 1099511628211ULL;
+    for (slot = hash % set->slots; set->rows[slot * n] != 0; slot = (slot + 1) % set->slots)
+        if (memcmp(set->rows + slot * n, h, n * sizeof(graph)) == 0)
+            return FALSE;
+    memcpy(set->rows + slot * n, h, n * sizeof(graph));
+    set->count++;
+    return TRUE;
+}
+
+/* Empty the set, keeping its slots for the next parent. */
+void clearchildren(childset *set, int n)
+{
+    if (set->count > 0)
+        memset(set->rows, 0, set->slots * n * sizeof(graph));
+    set->count = 0;
+}
+
+/* Label the graph g on n vertices canonically with nauty. If the vertex w is
+ * not negative, w and then a and b form their own cells of the partition, so
+ * that the canonical graphs of two such labellings are the same if and only if
+ * an automorphism maps one (w,{a,b}) to the other. */
+void canonical(graph *g, int n, int w, int a, int b, int *lab, int *orbits, graph *h)
+{
+    int i, j, ptn[MAXN];
+    DEFAULTOPTIONS_GRAPH(options);
+    statsblk stats;
+
+    options.getcanon = TRUE;
+    if (w >= 0)
+    {
+        options.defaultptn = FALSE;
+        j = 0;
+        for (i = 0; i < n; ++i)
+            if (i != w && i != a && i != b)
+                lab[j++] = i;
+        lab[j++] = a;
+        lab[j++] = b;
+        lab[j++] = w;
+        for (i = 0; i < n; ++i)
+            ptn[i] = 1;
+        ptn[n - 4] = ptn[n - 2] = ptn[n - 1] = 0;
+    }
+    densenauty(g, lab, ptn, orbits, &options, &stats, 1, n, h);
+}
+
+/* Whether removing v of degree three from g and adding the edge (a,b) between
+ * two of its neighbours leaves a Laman graph, i.e., the edge is not inside a
+ * rigid subgraph of g - v. */
+boolean reducible(graph *g, int n, int v, int a, int b)
+{
+    int i;
+    graph r[MAXN];
+
+    for (i = 0; i < n; ++i)
+        r[i] = g[i] & ~NTH_NODE(v);
+    r[v] = 0;
+    r[a] |= NTH_NODE(b);
+    r[b] |= NTH_NODE(a);
+    /* v is isolated and does not change whether r is sparse */
+    return pebblegame(r, n, 2, 3, 1) >= 0;
+}
+
+/* Find the edge (a,b) added by the canonical reduction of the vertex v of
+ * degree three, the one with the last endpoints in the canonical labelling.
+ *
+ * Returns:
+ * FALSE if v cannot be reduced
+ */
+boolean canonicaledge(graph *g, int n, int v, const int *position, int *a, int *b)
+{
+    int x, y, i, j, best;
+    int nb[3];
+    setword s;
+
+    s = g[v];
+    for (i = 0; i < 3; ++i)
+    {
+        nb[i] = FIRSTBITNZ(s);
+        s &= ~NTH_NODE(nb[i]);
+    }
+
+    best = -1;
+    for (i = 0; i < 3; ++i)
+        for (j = i + 1; j < 3; ++j)
+        {
+            x = position[nb[i]] > position[nb[j]] ? nb[i] : nb[j];
+            y = x == nb[i] ? nb[j] : nb[i];
+            if ((g[x] & NTH_NODE(y)) || MAXN * position[x] + position[y] <= best)
+                continue;
+            if (reducible(g, n, v, x, y))
+            {
+                best = MAXN * position[x] + position[y];
+                *a = x;
+                *b = y;
+            }
+        }
+    return best >= 0;
+}
+
+/* Decide whether the child h on n vertices, made by adding the vertex w = n-1
+ * and removing the edge (a,b) for a type II move or a = -1 for type I, is
+ * accepted, see the top of the file. The canonical graph is left in canon.
+ */
+boolean acceptchild(graph *h, int n, int a, int b, graph *canon)
+{
+    int i, v, w, ca, cb, mindegree;
+    int lab[MAXN], orbits[MAXN], position[MAXN];
+    int degree[MAXN];
+    graph g1[MAXN], g2[MAXN];
+
+    w = n - 1;
+    mindegree = 3;
+    for (i = 0; i < n; ++i)
+    {
+        degree[i] = POPCOUNT(h[i]);
+        if (degree[i] < mindegree)
+            mindegree = degree[i];
+    }
+    /* a vertex of degree two is always reduced first */
+    if (degree[w] != mindegree)
+        return FALSE;
+
+    canonical(h, n, -1, 0, 0, lab, orbits, canon);
+    for (i = 0; i < n; ++i)
+        position[lab[i]] = i;
+
+    /* the last reducible vertex of the lowest degree, w being one of them */
+    ca = cb = -1;
+    v = w;
+    for (i = n - 1; i >= 0; --i)
+    {
+        v = lab[i];
+        if (degree[v] == mindegree && (mindegree == 2 || canonicaledge(h, n, v, position, &ca, &cb)))
+            break;
+    }
+    if (orbits[v] != orbits[w])
+        return FALSE;
+    if (a < 0 || (v == w && ((a == ca && b == cb) || (a == cb && b == ca))))
+        return TRUE;
+
+    /* the reduction also has to agree on the edge */
+    canonical(h, n, w, a, b, lab, orbits, g1);
+    canonical(h, n, v, ca, cb, lab, orbits, g2);
+    return memcmp(g1, g2, n * sizeof(graph)) == 0;
+}
+
+void output(graph *g, int n)
+{
+    nout++;
+    if (!nooutput)
+        writeg6(stdout, g, 1, n);
+}
+
+void extend(graph *g, int n);
+
+/* Generate the child h on n vertices and its descendants unless it is
+ * rejected, see acceptchild. */
+void addchild(graph *h, int n, int a, int b)
+{
+    graph canon[MAXN];
+
+    if (!acceptchild(h, n, a, b, canon) || !insertchild(&children[n], canon, n))
+        return;
+    if (n == splitlevel && splitcount++ % mod != res)
+        return;
+    if (n == maxn)
+        output(canon, n);
+    else
+        extend(h, n);
+}
+
+/* Generate the descendants of g on n vertices. */
+void extend(graph *g, int n)
+{
+    int a, b, c, i;
+    graph h[MAXN];
+
+    for (a = 0; a < n; ++a)
+    {
+        for (b = a + 1; b < n; ++b)
+        {
+            /* type I: join the new vertex to a and b */
+            for (i = 0; i < n; ++i)
+                h[i] = g[i];
+            h[n] = NTH_NODE(a) | NTH_NODE(b);
+            h[a] |= NTH_NODE(n);
+            h[b] |= NTH_NODE(n);
+            addchild(h, n + 1, -1, -1);
+
+            /* type II: split the edge (a,b) with the new vertex, also joined to c */
+            if (!typeii || !(g[a] & NTH_NODE(b)))
+                continue;
+            for (c = 0; c < n; ++c)
+            {
+                if (c == a || c == b)
+                    continue;
+                for (i = 0; i < n; ++i)
+                    h[i] = g[i];
+                h[a] &= ~NTH_NODE(b);
+                h[b] &= ~NTH_NODE(a);
+                h[n] = NTH_NODE(a) | NTH_NODE(b) | NTH_NODE(c);
+                h[a] |= NTH_NODE(n);
+                h[b] |= NTH_NODE(n);
+                h[c] |= NTH_NODE(n);
+                addchild(h, n + 1, a, b);
+            }
+        }
+    }
+    clearchildren(&children[n + 1], n + 1);
+}
+
+int main(int argc, const char *argv[])
+{
+    int i, j, positional;
+    boolean quiet;
+    graph g[MAXN];
+    clock_t start;
+    char *end;
+
+    if (argc >= 2 && strcmp(argv[1], "-h") == 0)
+    {
+        printf("Usage: genhenneberg [-2uq] n [res/mod]\n");
+        return 0;
+    }
+
+    typeii = nooutput = quiet = FALSE;
+    maxn = -1;
+    res = 0;
+    mod = 1;
+    positional = 0;
+    for (i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] == '-')
+        {
+            for (j = 1; argv[i][j] != '\0'; ++j)
+            {
+                if (argv[i][j] == '2')
+                    typeii = TRUE;
+                else if (argv[i][j] == 'u')
+                    nooutput = TRUE;
+                else if (argv[i][j] == 'q')
+                    quiet = TRUE;
+                else
+                    gt_abort(">E genhenneberg: unknown argument\n");
+            }
+        }
+        else if (positional == 0)
+        {
+            maxn = strtol(argv[i], &end, 10);
+            if (*end != '\0')
+                gt_abort(">E genhenneberg: n has to be an integer\n");
+            positional++;
+        }
+        else if (positional == 1)
+        {
+            res = strtol(argv[i], &end, 10);
+            if (*end != '/' || (mod = strtol(end + 1, &end, 10)) < 1 || *end != '\0' || res < 0 || res >= mod)
+                gt_abort(">E genhenneberg: res/mod has to satisfy 0 <= res < mod\n");
+            positional++;
+        }
+        else
+            gt_abort(">E genhenneberg: unknown argument\n");
+    }
+    if (maxn < 1 || maxn > MAXN)
+        gt_abort(">E genhenneberg: n has to be between 1 and MAXN\n");
+
+    /* split late enough for the parts to be balanced but early enough to save
+     * the work of the other parts */
+    splitlevel = maxn - 2 < SPLITMINN ? maxn : maxn - 2;
+
+    if (!quiet)
+        fprintf(stderr, ">A genhenneberg n=%d type I%s moves\n", maxn, typeii ? " and II" : "");
+
+    start = clock();
+    nout = 0;
+    splitcount = 0;
+    /* the single vertex and the single edge have no reductions */
+    if (maxn <= 2)
+    {
+        if (mod == 1 || res == 0)
+        {
+            g[0] = maxn == 2 ? NTH_NODE(1) : 0;
+            g[1] = NTH_NODE(0);
+            output(g, maxn);
+        }
+    }
+    else
+    {
+        g[0] = NTH_NODE(1);
+        g[1] = NTH_NODE(0);
+        extend(g, 2);
+    }
+
+    if (!quiet)
+        fprintf(stderr, ">Z %llu graphs generated in %.2f sec\n", nout, (double)(clock() - start) / CLOCKS_PER_SEC);
+    return 0;
+}
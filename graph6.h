@@ -0,0 +1,211 @@
+/* Copyright (c) 2020 Martin Larsson */
+
+/* Reading of graph6 input shared by filter_sparse and filter_rank.
+ *
+ * Input that is a regular file is mapped into memory, and other input is read
+ * in large blocks, so that the lines can be handed out without copying them.
+ * The graphs are decoded a word at a time instead of a bit at a time. Only
+ * graphs with at most 62 vertices are supported.
+ *
+ * See http://users.cecs.anu.edu.au/~bdm/data/formats.txt */
+
+#ifndef GRAPH6_H
+#define GRAPH6_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define G6MAXN 62
+#define G6BLOCKSIZE (1 << 20)
+
+typedef struct
+{
+    const char *data; /* the mapped file, or buffer */
+    size_t size;
+    size_t pos;
+    char *buffer;
+    size_t capacity;
+    int fd;
+    int eof; /* no more input after data, always set for a mapped file */
+} g6reader;
+
+/* Start reading graph6 lines from the file descriptor fd.
+ *
+ * Returns:
+ * 0 on success and -1 if no memory could be allocated
+ */
+static int g6open(g6reader *r, int fd)
+{
+    struct stat st;
+    void *map;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = fd;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            r->data = (const char *)map;
+            r->size = st.st_size;
+            r->eof = 1;
+            return 0;
+        }
+    }
+
+    r->capacity = G6BLOCKSIZE;
+    r->buffer = (char *)malloc(r->capacity);
+    r->data = r->buffer;
+    return r->buffer ? 0 : -1;
+}
+
+static void g6close(g6reader *r)
+{
+    if (r->buffer)
+        free(r->buffer);
+    else if (r->data)
+        munmap((void *)r->data, r->size);
+    r->data = r->buffer = NULL;
+}
+
+/* The next line without the newline. The line stays valid until the next
+ * call. Only a line that does not fit in the remaining buffer is moved.
+ *
+ * Returns:
+ * the line, or NULL at the end of the input or if no memory could be allocated
+ */
+static const char *g6line(g6reader *r, size_t *length)
+{
+    const char *line, *newline;
+    size_t rest;
+    ssize_t got;
+    char *grown;
+
+    for (;;)
+    {
+        line = r->data + r->pos;
+        rest = r->size - r->pos;
+        newline = (const char *)memchr(line, '\n', rest);
+        if (newline)
+        {
+            *length = newline - line;
+            r->pos += *length + 1;
+            return line;
+        }
+        if (r->eof)
+        {
+            if (rest == 0)
+                return NULL;
+            *length = rest;
+            r->pos = r->size;
+            return line;
+        }
+
+        /* keep the partial line and read the next block after it */
+        if (rest == r->capacity)
+        {
+            grown = (char *)realloc(r->buffer, 2 * r->capacity);
+            if (!grown)
+                return NULL;
+            r->buffer = grown;
+            r->capacity *= 2;
+        }
+        memmove(r->buffer, r->buffer + r->pos, rest);
+        r->data = r->buffer;
+        r->pos = 0;
+        got = read(r->fd, r->buffer + rest, r->capacity - rest);
+        if (got <= 0)
+            got = 0, r->eof = 1;
+        r->size = rest + got;
+    }
+}
+
+/* Append the lowest b <= 48 bits of v to the bit stream in words. */
+#define G6APPEND(words, w, cur, used, v, b)           \
+    if ((used) + (b) < 64)                            \
+    {                                                 \
+        (cur) |= (v) << (64 - (used) - (b));          \
+        (used) += (b);                                \
+    }                                                 \
+    else                                              \
+    {                                                 \
+        (used) += (b)-64;                             \
+        (words)[(w)++] = (cur) | (v) >> (used);       \
+        (cur) = (used) ? (v) << (64 - (used)) : 0;    \
+    }
+
+/* Decode a graph6 string of the given length. lower[j] receives the
+ * neighbours i < j of vertex j, with vertex i in bit 63 - i.
+ *
+ * The string is first unpacked into a stream of 64-bit words. Eight
+ * characters at a time are turned into 48 bits by merging neighbouring 6-bit
+ * fields in parallel. Since the bits of vertex j follow the bits of vertex
+ * j - 1, the neighbours of j are then a single shifted word. Every character
+ * has to be in the range 63..126 of graph6, which is checked for the eight
+ * characters at once as well.
+ *
+ * Returns:
+ * the number of vertices, or -1 if the string is not a graph6 graph with at
+ * most G6MAXN vertices
+ */
+static int g6decode(const char *s, size_t length, uint64_t *lower)
+{
+    uint64_t words[(G6MAXN * (G6MAXN - 1) / 2 + 63) / 64 + 1];
+    uint64_t x, cur;
+    int n, j, w, used, offset, shift;
+    size_t chars, i;
+
+    if (length == 0 || s[0] < 63 || s[0] > 63 + G6MAXN)
+        return -1;
+    n = s[0] - 63;
+    chars = (n * (n - 1) / 2 + 5) / 6;
+    if (length < 1 + chars)
+        return -1;
+
+    w = 0;
+    used = 0;
+    cur = 0;
+    for (i = 1; i + 8 <= 1 + chars; i += 8)
+    {
+        memcpy(&x, s + i, 8);
+        /* c is in 63..126 if it is below 128 and c + 1 is in 64..127 */
+        if ((x & 0x8080808080808080ULL) ||
+            ((x + 0x0101010101010101ULL) & 0xC0C0C0C0C0C0C0C0ULL) != 0x4040404040404040ULL)
+            return -1;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        x -= 0x3F3F3F3F3F3F3F3FULL;
+        x = ((x & 0x3F003F003F003F00ULL) >> 2) | (x & 0x003F003F003F003FULL);
+        x = ((x & 0x0FFF00000FFF0000ULL) >> 4) | (x & 0x00000FFF00000FFFULL);
+        x = ((x & 0x00FFFFFF00000000ULL) >> 8) | (x & 0x0000000000FFFFFFULL);
+        G6APPEND(words, w, cur, used, x, 48)
+    }
+    for (; i < 1 + chars; ++i)
+    {
+        if (s[i] < 63 || s[i] > 126)
+            return -1;
+        x = (uint64_t)(s[i] - 63);
+        G6APPEND(words, w, cur, used, x, 6)
+    }
+    words[w] = cur;
+
+    lower[0] = 0;
+    for (j = 1; j < n; ++j)
+    {
+        offset = j * (j - 1) / 2;
+        shift = offset & 63;
+        x = words[offset >> 6] << shift;
+        if (shift + j > 64)
+            x |= words[(offset >> 6) + 1] >> (64 - shift);
+        lower[j] = x & ~(~0ULL >> j);
+    }
+    return n;
+}
+
+#endif
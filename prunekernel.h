@@ -0,0 +1,376 @@
+/* Copyright (c) 2020 Martin Larsson */
+
+/* The prune engines of prunesparse.h that depend on (k,l,N) in their inner
+ * loops. This file is included once for the generic engines, which read
+ * (k,l,N) from the options, and once for every instance in prunekernels, which
+ * has them as constants so that the compiler can fold TOO_MANY_EDGES and the
+ * pebble counts. There is no include guard.
+ *
+ * An instance is defined by the following macros, which are undefined again at
+ * the end of the file. The generic engines are included without them.
+ * KERNEL_SUFFIX - appended to the names of the functions of the instance.
+ * KERNEL_KN, KERNEL_KD, KERNEL_LN, KERNEL_LD - k and l as fractions.
+ * KERNEL_N - N.
+ * KERNEL_S - the least common multiple of the denominators, see scalekl.
+ */
+
+#ifndef KERNELNAME
+#define KERNELPASTE(name, suffix) name##suffix
+#define KERNELNAME(name, suffix) KERNELPASTE(name, suffix)
+#endif
+
+#ifdef KERNEL_SUFFIX
+#define KERNEL(name) KERNELNAME(name, KERNEL_SUFFIX)
+#define KERNEL_TOO_MANY_EDGES(n, m) \
+    (KERNEL_KD * KERNEL_LD * (m) > KERNEL_KN * KERNEL_LD * (n)-KERNEL_LN * KERNEL_KD)
+#define KERNEL_SK (KERNEL_KN * (KERNEL_S / KERNEL_KD))
+#define KERNEL_SL (KERNEL_LN * (KERNEL_S / KERNEL_LD))
+/* the scaled (k,l) and multiplicity passed to pebbleedge and pebblegame are
+ * replaced by the constants, which the callers pass anyway */
+#define KERNEL_CONSTANTS(k, l, s) ((k) = KERNEL_SK, (l) = KERNEL_SL, (s) = KERNEL_S)
+#else
+#define KERNEL(name) name
+#define KERNEL_TOO_MANY_EDGES(n, m) TOO_MANY_EDGES(n, m)
+#define KERNEL_N minn
+#define KERNEL_S scaledmult
+#define KERNEL_SK scaledk
+#define KERNEL_SL scaledl
+#define KERNEL_CONSTANTS(k, l, s) ((void)0)
+#endif
+
+/* Play an edge (i,j) of multiplicity s in the pebble game. Gathers l+s
+ * pebbles on the endpoints and covers each copy of the edge with one of them.
+ * mult is NULL for simple graphs, see find_pebble.
+ *
+ * Returns:
+ * FALSE if the edge cannot be added without the graph becoming overconstrained
+ * TRUE otherwise
+ */
+boolean KERNEL(pebbleedge)(graph *d, pebblemultrow *mult, int *pebbles, int n, int i, int j, int k, int l, int s)
+{
+    int v, needed;
+    setword free, tovisit;
+
+    KERNEL_CONSTANTS(k, l, s);
+    needed = l + s - pebbles[i] - pebbles[j];
+    if (needed > 0)
+    {
+        tovisit = ALLMASK(n) & ~NTH_NODE(i) & ~NTH_NODE(j);
+        free = 0;
+        for (v = 0; v < n; ++v)
+            if (pebbles[v] > 0)
+                free |= NTH_NODE(v);
+        free &= tovisit;
+
+        while (needed > 0 && pebbles[i] < k && (v = find_pebble(d, mult, free, tovisit, i)) >= 0)
+        {
+            needed--;
+            pebbles[i]++;
+            if (--pebbles[v] == 0)
+                free &= ~NTH_NODE(v);
+        }
+        while (needed > 0 && pebbles[j] < k && (v = find_pebble(d, mult, free, tovisit, j)) >= 0)
+        {
+            needed--;
+            pebbles[j]++;
+            if (--pebbles[v] == 0)
+                free &= ~NTH_NODE(v);
+        }
+        if (needed > 0)
+            return FALSE;
+    }
+
+    for (; s > 0; --s)
+    {
+        if (pebbles[i] > pebbles[j])
+        {
+            pebbles[i]--;
+            d[i] |= NTH_NODE(j);
+            if (mult != NULL)
+                mult[i][j]++;
+        }
+        else
+        {
+            pebbles[j]--;
+            d[j] |= NTH_NODE(i);
+            if (mult != NULL)
+                mult[j][i]++;
+        }
+    }
+    return TRUE;
+}
+
+/* Determine whether the provided graph on n vertices is (k,l)-tight, (k,l)-sparse, or
+ * overconstrained. Every edge is played with multiplicity s, so that scaled
+ * rational (k,l) can be used, see scalekl.
+
+ * See Lee and Streinu (2008) Pebble game algorithms and sparse graphs
+ *
+ * Returns:
+ * <0 if the graph is overconstrained
+ * 0 if the graph is (k,l)-tight
+ * >0 if the graph is (k,l)-sparse
+ */
+int KERNEL(pebblegame)(graph *g, int n, int k, int l, int s)
+{
+    int i, j, total;
+    int pebbles[MAXN];
+    graph d[MAXN] = {0};
+    pebblemultrow mult[MAXN];
+
+    KERNEL_CONSTANTS(k, l, s);
+    for (i = 0; i < n; ++i)
+        pebbles[i] = k;
+    if (s > 1)
+        memset(mult, 0, sizeof(mult));
+
+    for (i = 0; i < n; ++i)
+    {
+        for (j = 0; j < i; ++j)
+        {
+            if ((g[i] & NTH_NODE(j)) == 0)
+                continue;
+
+            // (i,j) is an edge.
+            if (!KERNEL(pebbleedge)(d, s > 1 ? mult : NULL, pebbles, n, i, j, k, l, s))
+                return -1;
+        }
+    }
+
+    total = 0;
+    for (i = 0; i < n; ++i)
+        total += pebbles[i];
+    return total - l;
+}
+
+/* remove graphs that are not (k,l)-sparse
+ * seems to have better performance than prunetightgray for k < 2 */
+int KERNEL(prunetightcomb)(graph *g, int n, int maxn)
+{
+    int i, k, l, m;
+    int nodeinds[MAXN];
+    int in, out;
+    setword mask;
+
+    /* small graphs are considered sparse */
+    if (n <= KERNEL_N)
+        return FALSE;
+
+    /* find number of edges */
+    m = 0;
+    for (i = 0; i < n; ++i)
+        m += POPCOUNT(g[i]);
+    m = m / 2;
+
+    /* subgraph is overdetermined => not sparse */
+    if (KERNEL_TOO_MANY_EDGES(n, m))
+    {
+        PRUNECOUNT(edgecheck, 1);
+        return TRUE;
+    }
+    if (n >= SUBSETMINN)
+    {
+        if (!subsetviolation(g, n - 1, NTH_NODE(n - 1), KERNEL_S, KERNEL_SK, KERNEL_SL, KERNEL_N))
+            return FALSE;
+        PRUNECOUNT(subsetcheck, 1);
+        return TRUE;
+    }
+
+    /* Go through all subgraphs verifying sparsity. geng constructs graphs by
+     * successively adding more nodes. Therefore, we only need to check the
+     * subgraphs containing the new last node. The other subgraphs have been
+     * checked in previous steps. The first subgraph consists of all nodes
+     * except the second to last one. */
+    l = m - POPCOUNT(g[n - 2]);
+    mask = ALLMASK(n) & ~NTH_NODE(n - 2);
+    for (i = 0; i < n - 1; ++i)
+        nodeinds[i] = i;
+
+    /* go through all k-vertex subgraphs */
+    for (k = n - 1; k > KERNEL_N; --k)
+    {
+        PRUNECOUNT(subsets, 1);
+        if (KERNEL_TOO_MANY_EDGES(k, l))
+        {
+            PRUNECOUNT(subsetcheck, 1);
+            return TRUE;
+        }
+
+        while (nxksrd(n - 1, k - 1, nodeinds, &in, &out))
+        {
+            l -= POPCOUNT(g[out] & mask);
+            mask ^= NTH_NODE(out);
+            mask ^= NTH_NODE(in);
+            l += POPCOUNT(g[in] & mask);
+
+            PRUNECOUNT(subsets, 1);
+            if (KERNEL_TOO_MANY_EDGES(k, l))
+            {
+                PRUNECOUNT(subsetcheck, 1);
+                return TRUE;
+            }
+        }
+        /* nodeinds == 0..k-2, in == k-2, out == n-2 */
+        l -= POPCOUNT(g[out] & mask);
+        mask ^= NTH_NODE(out);
+    }
+    return FALSE;
+}
+
+/* remove graphs that are not (k,l)-sparse
+ * seems to have better performance than prunetightcomb for k >= 2 */
+int KERNEL(prunetightgray)(graph *g, int n, int maxn)
+{
+    int i, j, m, k, l, degree;
+    setword mask;
+
+    /* small graphs are considered sparse */
+    if (n <= KERNEL_N)
+        return FALSE;
+
+    /* find number of edges */
+    m = 0;
+    for (i = 0; i < n; ++i)
+        m += POPCOUNT(g[i]);
+    m = m / 2;
+
+    /* subgraph is overdetermined => not sparse */
+    if (KERNEL_TOO_MANY_EDGES(n, m))
+    {
+        PRUNECOUNT(edgecheck, 1);
+        return TRUE;
+    }
+    if (n >= SUBSETMINN)
+    {
+        if (!subsetviolation(g, n - 1, NTH_NODE(n - 1), KERNEL_S, KERNEL_SK, KERNEL_SL, KERNEL_N))
+            return FALSE;
+        PRUNECOUNT(subsetcheck, 1);
+        return TRUE;
+    }
+
+    /* Go through all subgraphs verifying sparsity. We use the Gray code binary
+     * representation of i as a mask for which nodes are included in the
+     * subgraph. This way, in every iteration, we either add or remove a single
+     * node to the previous subgraph. */
+    k = 1;
+    l = 0;
+    mask = NTH_NODE(n - 1); /* always include the new node */
+    for (i = 1; i < (1 << n - 1); ++i)
+    {
+        j = CTZ(i);
+        mask ^= NTH_NODE(j); /* add or remove node */
+        degree = POPCOUNT(g[j] & mask);
+        l += mask & NTH_NODE(j) ? degree : -degree;
+        k += mask & NTH_NODE(j) ? 1 : -1;
+
+        if (k > KERNEL_N && KERNEL_TOO_MANY_EDGES(k, l))
+        {
+            PRUNECOUNT(subsets, i);
+            PRUNECOUNT(subsetcheck, 1);
+            return TRUE;
+        }
+    }
+    PRUNECOUNT(subsets, i - 1);
+    return FALSE;
+}
+
+/* remove graphs that are not (k,l)-sparse
+ * performs much better than the other methods whenever setuppebblegame succeeds
+ *
+ * geng constructs graphs by adding a vertex to a graph accepted one level up,
+ * so the pebble game is continued from the final state of the parent and only
+ * the edges of the new vertex are played. */
+int KERNEL(prunetightpebble)(graph *g, int n, int maxn)
+{
+    int i, m;
+    setword nb;
+    pebblemultrow *mult;
+
+    m = pebblestate(g, n);
+
+    /* subgraph is overdetermined => not sparse */
+    if (n > KERNEL_N && KERNEL_TOO_MANY_EDGES(n, m))
+    {
+        PRUNECOUNT(edgecheck, 1);
+        return TRUE;
+    }
+
+    /* play the edges of the new vertex */
+    mult = KERNEL_S > 1 ? pebblemult[n] : NULL;
+    nb = g[n - 1];
+    while (nb)
+    {
+        i = FIRSTBITNZ(nb);
+        nb &= ~NTH_NODE(i);
+        if (!KERNEL(pebbleedge)(pebbleorient[n], mult, pebblecount[n], n, n - 1, i, KERNEL_SK, KERNEL_SL, KERNEL_S))
+        {
+            PRUNECOUNT(pebblegame, 1);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* remove graphs that are not (k,l)-sparse
+ * same as prunetightpebble but also maintains the tight components, see Lee
+ * and Streinu (2008). An edge with both endpoints in a common component is
+ * rejected without searching for pebbles. */
+int KERNEL(prunetightpebblecomp)(graph *g, int n, int maxn)
+{
+    int i, m;
+    setword nb;
+    graph *d;
+    pebblemultrow *mult;
+    int *pebbles;
+    setword *comp;
+
+    m = pebblestate(g, n);
+    d = pebbleorient[n];
+    mult = KERNEL_S > 1 ? pebblemult[n] : NULL;
+    pebbles = pebblecount[n];
+    comp = pebblecomp[n];
+    for (i = 0; i < n - 1; ++i)
+        comp[i] = pebblecomp[n - 1][i];
+    comp[n - 1] = 0;
+
+    /* subgraph is overdetermined => not sparse */
+    if (n > KERNEL_N && KERNEL_TOO_MANY_EDGES(n, m))
+    {
+        PRUNECOUNT(edgecheck, 1);
+        return TRUE;
+    }
+
+    /* play the edges of the new vertex */
+    nb = g[n - 1];
+    while (nb)
+    {
+        i = FIRSTBITNZ(nb);
+        nb &= ~NTH_NODE(i);
+        if (comp[n - 1] & NTH_NODE(i))
+        {
+            PRUNECOUNT(pebblegame, 1);
+            return TRUE;
+        }
+        if (!KERNEL(pebbleedge)(d, mult, pebbles, n, n - 1, i, KERNEL_SK, KERNEL_SL, KERNEL_S))
+        {
+            PRUNECOUNT(pebblegame, 1);
+            return TRUE;
+        }
+        if (pebbles[n - 1] + pebbles[i] == KERNEL_SL)
+            pebblecomponent(d, pebbles, comp, n, n - 1, i);
+    }
+    return FALSE;
+}
+
+#undef KERNEL
+#undef KERNEL_TOO_MANY_EDGES
+#undef KERNEL_SK
+#undef KERNEL_SL
+#undef KERNEL_CONSTANTS
+#undef KERNEL_SUFFIX
+#undef KERNEL_KN
+#undef KERNEL_KD
+#undef KERNEL_LN
+#undef KERNEL_LD
+#undef KERNEL_N
+#undef KERNEL_S
@@ -3,6 +3,13 @@
 /* Using rationals for (k,l) comes with a small overhead. Define this macro to use integers for (k,l). */
 // #define INT_KL
 
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
 #define NTH_NODE(n) (bit[n]) /* Apparently lookup is faster than bitshift. */
 
 /* Comment out if __builtin_ctz is missing. */
@@ -23,17 +30,56 @@ static const int MultiplyDeBruijnBitPosition[32] =
 // #define CTZ(x) (ffs(x) - 1) // This is ridiculously slow...
 #endif
 
-/* Pruning function. */
+/* Pruning function. Define PRUNE_INSTRUMENT to count the calls at each depth,
+ * the rejections by reason and the work done by the engines, see
+ * pruneinstrumented. PRUNECOUNT(counter, x) adds x to a counter of the
+ * current depth and compiles to nothing otherwise. The names differ from
+ * INSTRUMENT, which turns on the counters of geng itself when defined. */
+#ifdef PRUNE_INSTRUMENT
+#define PRUNE pruneinstrumented
+#define PRUNECOUNT(counter, x) (instrument[instrumentdepth].counter += (x))
+#define PRUNEREPORT(levels) reportinstrument(levels)
+#else
 #define PRUNE (*prune)
+#define PRUNECOUNT(counter, x)
+#define PRUNEREPORT(levels)
+#endif
+
+/* Number of units of work per process when splitting with -J. */
+#define UNITSPERPROCESS 16
+
+/* Number of probes of the search tree made to calibrate the progress with -I. */
+#define PROGRESSPROBES 16
+
+/* Number of probes of the search tree made to time the engines with -A, and
+ * the number of engines timed, see selectautoengines. */
+#define AUTOPROBES 16
+#define AUTOENGINES 5
+
+/* Maximum number of filters run on the generated graphs, see pruneoutput. */
+#define OUTPUTFILTERS 3
+
+/* Outside the range of the pebble game, graphs with fewer vertices than this
+ * are checked by going through their subgraphs rather than with flows. */
+#ifndef FLOWMINN
+#define FLOWMINN 20
+#endif
+
+/* Subgraphs of graphs with at least this many vertices are checked in blocks,
+ * see subsetviolation. The low block has at most 2^SUBSETLOWBITS subsets. */
+#ifndef SUBSETMINN
+#define SUBSETMINN 12
+#endif
+#define SUBSETLOWBITS 10
 
 /* Parse plugin arguments. */
 #ifdef INT_KL
 #define TOO_MANY_EDGES(n, m) ((m) > tightkn * (n)-tightln)
-#define PLUGIN_SWITCHES else SWINT('K', gotK, tightkn, "gensparseg -K") else SWINT('L', gotL, tightln, "gensparseg -L") else SWBOOLEAN('H', henneberg1) else SWINT('N', gotN, minn, "gensparseg -N")
+#define PLUGIN_SWITCHES else SWINT('K', gotK, tightkn, "gensparseg -K") else SWINT('L', gotL, tightln, "gensparseg -L") else SWBOOLEAN('H', henneberg1) else SWINT('N', gotN, minn, "gensparseg -N") else SWBOOLEAN('M', pebblecomponents) else SWINT('J', gotJ, processes, "gensparseg -J") else SWINT('E', gotE, estimate, "gensparseg -E") else SWINT('I', gotI, progress, "gensparseg -I") else SWINT('R', gotR, rigiddim, "gensparseg -R") else SWBOOLEAN('G', statistics) else SWBOOLEAN('A', autoengine) else SWBOOLEAN('O', sparsitycheck) else SWINT('V', gotV, rankdim, "gensparseg -V") else SWINT('W', gotW, rankdof, "gensparseg -W")
 #define PRINT_LAMAN_MESSAGE fprintf(stderr, ">A Laman plugin -K%dL%dN%d\n", tightkn, tightln, minn);
 #else
 #define TOO_MANY_EDGES(n, m) (tightkd * tightld * (m) > tightkn * tightld * (n)-tightln * tightkd)
-#define PLUGIN_SWITCHES else SWRANGE('K', "/", gotK, tightkn, tightkd, "gensparseg -K") else SWRANGE('L', "/", gotL, tightln, tightld, "gensparseg -L") else SWBOOLEAN('H', henneberg1) else SWINT('N', gotN, minn, "gensparseg -N")
+#define PLUGIN_SWITCHES else SWRANGE('K', "/", gotK, tightkn, tightkd, "gensparseg -K") else SWRANGE('L', "/", gotL, tightln, tightld, "gensparseg -L") else SWBOOLEAN('H', henneberg1) else SWINT('N', gotN, minn, "gensparseg -N") else SWBOOLEAN('M', pebblecomponents) else SWINT('J', gotJ, processes, "gensparseg -J") else SWINT('E', gotE, estimate, "gensparseg -E") else SWINT('I', gotI, progress, "gensparseg -I") else SWINT('R', gotR, rigiddim, "gensparseg -R") else SWBOOLEAN('G', statistics) else SWBOOLEAN('A', autoengine) else SWBOOLEAN('O', sparsitycheck) else SWINT('V', gotV, rankdim, "gensparseg -V") else SWINT('W', gotW, rankdof, "gensparseg -W")
 #define PRINT_LAMAN_MESSAGE                                                        \
     if (tightkd == 1 && tightld == 1)                                              \
         fprintf(stderr, ">A Laman plugin -K%ldL%ldN%d\n", tightkn, tightln, minn); \
@@ -44,6 +90,16 @@ static const int MultiplyDeBruijnBitPosition[32] =
 /* Note: PLUGIN_INIT happens after validation of the input arguments in geng.c.
  * Beware of illegal argument combinations. */
 #define PLUGIN_INIT                                                                                       \
+    if (gotR)                                                                                             \
+    {                                                                                                     \
+        if (rigiddim < 1)                                                                                 \
+            gt_abort(">E gensparseg: -R has to be at least 1\n");                                         \
+        if (!gotK)                                                                                        \
+        {                                                                                                 \
+            tightkn = rigiddim;                                                                           \
+            tightkd = 1;                                                                                  \
+        }                                                                                                 \
+    }                                                                                                     \
     if (tightkn == tightkd)                                                                               \
         tightkd = 1;                                                                                      \
     else if (tightkd == 0)                                                                                \
@@ -88,30 +144,46 @@ static const int MultiplyDeBruijnBitPosition[32] =
         while (!TOO_MANY_EDGES(minn + 1, minn * (minn + 1) / 2))                                          \
             minn++;                                                                                       \
     }                                                                                                     \
+    if (sparsitycheck && (henneberg1 || pebblecomponents || autoengine || !(gotK || gotR)))               \
+        gt_abort(">E gensparseg: -O requires -K or -R and is incompatible with -AHM\n");                  \
+    selectkernel();                                                                                       \
     if (henneberg1)                                                                                       \
     {                                                                                                     \
         prune = prunehenneberg1;                                                                          \
         if (tightkd != 1)                                                                                 \
             gt_abort(">E gensparseg: -K has to be an integer\n");                                         \
-        if (gotd || gote || gotL)                                                                         \
-            gt_abort(">E gensparseg: -deL are incompatible with -H\n");                                   \
+        if (gotd || gote || gotL || gotR)                                                                 \
+            gt_abort(">E gensparseg: -deLR are incompatible with -H\n");                                  \
     }                                                                                                     \
-    else if (gotK)                                                                                        \
+    else if (gotR)                                                                                        \
     {                                                                                                     \
-        if (tightkd == 1 && tightld == 1 && tightln >= 0 && tightln < 2 * tightkn && minn <= tightkn + 1) \
-            prune = prunetightpebble;                                                                     \
+        prune = prunerigidity;                                                                            \
+        setuprigidity(maxn);                                                                              \
+        if (pebblecomponents)                                                                             \
+            gt_abort(">E gensparseg: -M is only supported when the pebble game is used\n");               \
+    }                                                                                                     \
+    else if (gotK && !sparsitycheck)                                                                      \
+    {                                                                                                     \
+        if (setuppebblegame())                                                                            \
+            prune = pebblecomponents ? kernel->pebblecomp : kernel->pebble;                               \
+        else if (pebblecomponents)                                                                        \
+            gt_abort(">E gensparseg: -M is only supported when the pebble game is used\n");               \
+        else if (maxn >= FLOWMINN)                                                                        \
+            prune = prunetightflow;                                                                       \
         else if (tightkn < 2 * tightkd)                                                                   \
-            prune = prunetightcomb;                                                                       \
+            prune = kernel->comb;                                                                         \
         else                                                                                              \
-            prune = prunetightgray;                                                                       \
+            prune = kernel->gray;                                                                         \
     }                                                                                                     \
+    else if (pebblecomponents)                                                                            \
+        gt_abort(">E gensparseg: -K is required when providing -M\n");                                    \
     else                                                                                                  \
     {                                                                                                     \
         prune = nopruning;                                                                                \
-        if (gotL)                                                                                         \
+        if (gotL && !gotK)                                                                                \
             gt_abort(">E gensparseg: -K is required when providing -L\n");                                \
     }                                                                                                     \
-    if (henneberg1 || gotK)                                                                               \
+    if (henneberg1 || (gotK && !sparsitycheck) || gotR)                                                   \
     {                                                                                                     \
         int maxtightedges = (tightkn * tightld * maxn - tightln * tightkd) / (tightkd * tightld);         \
         if (maxn <= minn)                                                                                 \
@@ -124,8 +196,106 @@ static const int MultiplyDeBruijnBitPosition[32] =
             geng_mindeg = mindeg = tightkn / tightkd;                                                     \
         if (!quiet)                                                                                       \
             PRINT_LAMAN_MESSAGE                                                                           \
+    }                                                                                                     \
+    if (gotJ && processes < 1)                                                                            \
+        gt_abort(">E gensparseg: -J has to be at least 1\n");                                             \
+    if ((gotE && estimate < 1) || (gotI && progress < 1))                                                 \
+        gt_abort(">E gensparseg: -E and -I have to be at least 1\n");                                     \
+    if (progress > 0 && processes > 1)                                                                    \
+        gt_abort(">E gensparseg: -I is not available together with -J\n");                                \
+    if (autoengine)                                                                                       \
+    {                                                                                                     \
+        if (!gotK || henneberg1 || gotR || pebblecomponents)                                              \
+            gt_abort(">E gensparseg: -A requires -K and is incompatible with -HMR\n");                    \
+        autopebble = setupautoengines();                                                                  \
+        processunit = processpool(processes, AUTOPROBES, TRUE);                                           \
+        if (processunit >= 0)                                                                             \
+        {                                                                                                 \
+            pruneengine = prunecalibrate;                                                                 \
+            prune = prunesampled;                                                                         \
+            probing = TRUE;                                                                               \
+            samplerandom += processunit * 0x9E3779B97F4A7C15ULL;                                          \
+            nooutput = quiet = TRUE;                                                                      \
+        }                                                                                                 \
+        else                                                                                              \
+        {                                                                                                 \
+            selectautoengines(AUTOPROBES, maxn);                                                          \
+            if (!quiet)                                                                                   \
+                reportautoengines(maxn);                                                                  \
+            prune = pruneauto;                                                                            \
+        }                                                                                                 \
+    }                                                                                                     \
+    if (gotW && !gotV)                                                                                    \
+        gt_abort(">E gensparseg: -W requires -V\n");                                                      \
+    if (gotV && (rankdim < 1 || rankdof < 0))                                                             \
+        gt_abort(">E gensparseg: -V has to be at least 1 and -W cannot be negative\n");                   \
+    if ((sparsitycheck || gotV || statistics) && !probing)                                                \
+    {                                                                                                     \
+        outputengine = prune;                                                                             \
+        prune = pruneoutput;                                                                              \
+        if (sparsitycheck)                                                                                \
+        {                                                                                                 \
+            outputpebble = setuppebblegame();                                                             \
+            outputfilters[outputfiltercount++] = filtersparse;                                            \
+        }                                                                                                 \
+        if (gotV)                                                                                         \
+        {                                                                                                 \
+            setuprankfilter(maxn);                                                                        \
+            outputfilters[outputfiltercount++] = filterrank;                                              \
+        }                                                                                                 \
+        if (statistics)                                                                                   \
+        {                                                                                                 \
+            outputfilters[outputfiltercount++] = filterstatistics;                                        \
+            statn = maxn;                                                                                 \
+            nooutput = TRUE;                                                                              \
+        }                                                                                                 \
+    }                                                                                                     \
+    if ((estimate > 0 || progress > 0) && !probing)                                                       \
+    {                                                                                                     \
+        int probes = estimate > 0 ? estimate : PROGRESSPROBES;                                            \
+        pruneengine = prune;                                                                              \
+        prune = prunesampled;                                                                             \
+        processunit = processpool(processes, probes, TRUE);                                               \
+        if (processunit >= 0)                                                                             \
+        {                                                                                                 \
+            probing = TRUE;                                                                               \
+            samplerandom += processunit * 0x9E3779B97F4A7C15ULL;                                          \
+            nooutput = quiet = TRUE;                                                                      \
+        }                                                                                                 \
+        else if (estimate > 0)                                                                            \
+        {                                                                                                 \
+            reportestimate(probes, maxn);                                                                 \
+            exit(0);                                                                                      \
+        }                                                                                                 \
+        else                                                                                              \
+            setprogresslevels(probes, maxn);                                                              \
+    }                                                                                                     \
+    if (processes > 1 && !probing)                                                                        \
+    {                                                                                                     \
+        processunit = processpool(processes, processes * UNITSPERPROCESS, nooutput && !statistics);       \
+        if (processunit < 0)                                                                              \
+        {                                                                                                 \
+            if (!quiet)                                                                                   \
+                reportprocesses(processes * UNITSPERPROCESS);                                             \
+            if (statistics)                                                                               \
+                printstatistics(statgraphs);                                                              \
+            exit(0);                                                                                      \
+        }                                                                                                 \
+        res += mod * processunit;                                                                         \
+        mod *= processes * UNITSPERPROCESS;                                                               \
+        quiet = TRUE;                                                                                     \
     }
 
+/* Report the number of graphs generated by a child process, see processpool,
+ * or the counters of PRUNE_INSTRUMENT, and print the histograms of -G. */
+#define SUMMARY(nout, t)                  \
+    if (processunit >= 0)                 \
+        summarizeunit(nout, t);           \
+    else if (!quiet)                      \
+        PRUNEREPORT(instrument);     \
+    if (statistics && !probing)           \
+        printstatistics(nout);
+
 static int (*prune)(graph *, int, int);
 static boolean gotK = FALSE;
 static boolean gotL = FALSE;
@@ -143,6 +313,133 @@ static long tightld = 1;
 #endif
 static int minn = 2;
 static boolean henneberg1 = FALSE;
+static boolean pebblecomponents = FALSE;
+static boolean gotJ = FALSE;
+static int processes = 1;
+
+static boolean gotE = FALSE;
+static int estimate = 0;
+static boolean gotI = FALSE;
+static int progress = 0;
+
+static boolean gotR = FALSE;
+static int rigiddim = 0;
+
+/* Filters of -O and -V, see pruneoutput. */
+static boolean sparsitycheck = FALSE;
+static boolean gotV = FALSE;
+static int rankdim = 0;
+static boolean gotW = FALSE;
+static int rankdof = 0;
+
+/* Histograms of the generated graphs with -G, see filterstatistics. */
+typedef struct
+{
+    unsigned char degrees[MAXN]; /* nonincreasing, padded with zeros */
+    unsigned long long count;    /* zero for an empty slot */
+} degreesequence;
+static boolean statistics = FALSE;
+static int statn;
+static unsigned long long statgraphs;
+static unsigned long long statedges[MAXN * (MAXN - 1) / 2 + 1];
+static unsigned long long statmindegree[MAXN + 1];
+static unsigned long long statmaxdegree[MAXN + 1];
+static unsigned long long statdegree[MAXN + 1][MAXN + 1]; /* graphs with c vertices of degree d at [d][c] */
+static degreesequence *statsequences;                     /* open addressing, see addsequence */
+static size_t statsequencecount, statsequenceslots;
+
+#ifdef PRUNE_INSTRUMENT
+/* Counters of PRUNE_INSTRUMENT for one depth. The rejections are split by the
+ * check that failed, which are the total number of edges, a search of the
+ * subsets or flows, the pebble game, the Henneberg moves, and the rigidity
+ * matroid. The ticks are cycles where available, see pruneticks. */
+typedef struct
+{
+    unsigned long long calls, rejected;
+    unsigned long long edgecheck, subsetcheck, pebblegame, henneberg, rigidity;
+    unsigned long long subsets;  /* subsets gone through */
+    unsigned long long flows;    /* densest subgraphs found */
+    unsigned long long searches; /* calls to find_pebble */
+    unsigned long long searchsteps;
+    unsigned long long ticks;
+} instrumentlevel;
+static instrumentlevel instrument[MAXN + 1];
+static int instrumentdepth;
+#endif
+
+/* Summary of a unit of work generated by a child process. */
+typedef struct
+{
+    unsigned long long count;
+    double seconds;
+    double nodes[MAXN + 1]; /* estimated number of graphs at each level with -E */
+    double autocost[AUTOENGINES][MAXN + 1]; /* estimated ticks of the engines with -A */
+#ifdef PRUNE_INSTRUMENT
+    instrumentlevel instrument[MAXN + 1];
+#endif
+} unitsummary;
+
+/* The unit of work generated by this process when split with -J or -E, or
+ * -1, and the summaries of all units, shared between processes. */
+static int processunit = -1;
+static unitsummary *unitsummaries;
+
+/* Sampling with -E and progress with -I, see prunesampled. */
+static int (*pruneengine)(graph *, int, int);
+static unsigned long long samplerandom = 0x2545F4914F6CDD1DULL;
+static unsigned long long prunecalls = 0;
+static double samplecalls = 0;                   /* estimated number of calls to prune */
+static double sampleweight[MAXN + 1] = {1, 1};   /* inverse sampling probability of the current path */
+static double samplenodes[MAXN + 1];             /* estimated number of graphs at each level */
+static unsigned long long levelchildren[MAXN + 1]; /* graphs accepted by the engine at each level */
+static unsigned long long levelsampled[MAXN + 1] = {1, 1};
+static unsigned long long levelsiblings[MAXN + 2]; /* position of the current path among its siblings */
+static double levelaverage[MAXN + 1];              /* estimated average number of children */
+static boolean probing = FALSE;
+static time_t progressstart, progresslast;
+
+/* Engine of every depth with -A, see selectautoengines. */
+static boolean autoengine = FALSE;
+static boolean autopebble; /* whether the pebble game can be used */
+static double autocost[AUTOENGINES][MAXN + 1];
+static int (*autoengines[MAXN + 1])(graph *, int, int);
+
+/* (k,l) scaled to integers for the multigraph where every edge has
+ * multiplicity scaledmult, see scalekl. */
+static int scaledk = 2;
+static int scaledl = 3;
+static int scaledmult = 1;
+
+/* Rigidity matroid in rigiddim dimensions over GF(RIGIDPRIME), see
+ * prunerigidity. The rows of the basis are shared between the depths since the
+ * rows of the graph at depth n are the rows at depth n-1 followed by the rows
+ * of the edges of the new vertex. */
+#define RIGIDPRIME ((1ULL << 61) - 1)
+static unsigned long long *rigidpoint; /* coordinates of the vertices */
+static unsigned long long *rigidrows;  /* basis in echelon form, rigidstride per row */
+static int *rigidpivot;                /* pivot column of each row of the basis */
+static int rigidstride;
+static int rigidrank[MAXN + 1]; /* rank of the graph accepted at each depth */
+
+/* The filters run in order on the graphs on maxn vertices accepted by
+ * outputengine, see pruneoutput. The rank filter of -V has its own random
+ * realization in rankdim dimensions, see filterrank. */
+static int (*outputengine)(graph *, int, int);
+static int (*outputfilters[OUTPUTFILTERS])(graph *, int);
+static int outputfiltercount;
+static boolean outputpebble; /* whether -O uses the pebble game */
+static unsigned long long *rankpoint;
+static unsigned long long *rankrows;
+static int *rankpivot;
+static int rankstride;
+
+/* Final pebble game state of the graph accepted at each depth. */
+typedef unsigned char pebblemultrow[MAXN];
+static graph pebbleorient[MAXN + 1][MAXN];
+static pebblemultrow pebblemult[MAXN + 1][MAXN]; /* only used for multiplicities above one */
+static int pebblecount[MAXN + 1][MAXN];
+static int pebbleedges[MAXN + 1];
+static setword pebblecomp[MAXN + 1][MAXN]; /* union of the tight components containing each vertex */
 
 /* Generates the next combination of k items from n possible ones, i.e., the
  * next k-subset of an n-set. If A is initialized with the items 0..k-1,
@@ -229,111 +526,318 @@ inline boolean nxksrd(int n, int k, int *restrict A, int *restrict in, int *rest
     return FALSE;
 }
 
-int find_pebble(graph *d, int *pebbles, int n, setword *tovisit, int i)
+/* Search the oriented graph d for a free pebble reachable from i. Only the
+ * vertices in tovisit are visited and the vertices in free hold a free pebble.
+ * Every visited vertex tests its whole out-row against free in one word
+ * operation before the search descends further. The search is iterative and
+ * the stack holds the current path, which is reversed when a free pebble is
+ * found, moving the pebble to i. For multigraphs, mult holds the number of
+ * edges oriented from one vertex to another and d only marks the nonzero
+ * entries. mult is NULL for simple graphs.
+ *
+ * Returns:
+ * the vertex the pebble was taken from, or -1 if no free pebble is reachable
+ */
+int find_pebble(graph *d, pebblemultrow *mult, setword free, setword tovisit, int i)
 {
-    int j;
-    while (d[i] & *tovisit)
-    {
-        j = FIRSTBITNZ(d[i] & *tovisit);
-        *tovisit &= ~NTH_NODE(j);
+    int j, v, top, pebble;
+    int stack[MAXN];
+    setword found;
 
-        if (pebbles[j] > 0)
+    PRUNECOUNT(searches, 1);
+    top = 0;
+    v = i;
+    for (;;)
+    {
+        found = d[v] & tovisit;
+        if (found & free)
         {
-            pebbles[j]--;
-            d[i] &= ~NTH_NODE(j);
-            d[j] |= NTH_NODE(i);
-            return TRUE;
+            pebble = FIRSTBITNZ(found & free);
+            j = pebble;
+            for (;;)
+            {
+                if (mult == NULL)
+                {
+                    d[v] &= ~NTH_NODE(j);
+                    d[j] |= NTH_NODE(v);
+                }
+                else
+                {
+                    if (--mult[v][j] == 0)
+                        d[v] &= ~NTH_NODE(j);
+                    if (mult[j][v]++ == 0)
+                        d[j] |= NTH_NODE(v);
+                }
+                if (top == 0)
+                    return pebble;
+                j = v;
+                v = stack[--top];
+            }
         }
-        else if (find_pebble(d, pebbles, n, tovisit, j))
+        if (found)
         {
-            d[i] &= ~NTH_NODE(j);
-            d[j] |= NTH_NODE(i);
-            return TRUE;
+            PRUNECOUNT(searchsteps, 1);
+            j = FIRSTBITNZ(found);
+            tovisit &= ~NTH_NODE(j);
+            stack[top++] = v;
+            v = j;
         }
+        else if (top > 0)
+            v = stack[--top];
+        else
+            return -1;
     }
+}
+
+/* dummy function when no pruning is applied */
+int nopruning(graph *g, int n, int maxn)
+{
     return FALSE;
 }
 
-/* Determine whether the provided graph on n vertices is (k,l)-tight, (k,l)-sparse, or
- * overconstrained.
+/* Determine whether a set of vertices consisting of the vertices in forced and
+ * any subset of the first f vertices violates (k,l)-sparsity, where the scaled
+ * s, sk and sl are given as in scalekl and sets on at most N vertices are
+ * exempt. The first a vertices form a low block and the rest a high block.
+ * Tables hold the weight s*m - k*n of every low subset together with the
+ * forced vertices. The high subsets are walked in Gray code order and, for
+ * each of them, the edges to every low subset are built from the degrees into
+ * the high subset, doubling the table one vertex at a time. Both passes over
+ * the low subsets are branch free loops over contiguous arrays, which the
+ * compiler vectorizes.
+ *
+ * Returns:
+ * TRUE if there is such a set
+ */
+boolean subsetviolation(graph *g, int f, setword forced, int s, int k, int l, int N)
+{
+    int i, j, a, x, half, row, size, base, limit, violation;
+    int lowweight[1 << SUBSETLOWBITS];
+    int lowsize[1 << SUBSETLOWBITS];
+    int cross[1 << SUBSETLOWBITS];
+    int degree[SUBSETLOWBITS];
+    setword mask;
+
+    a = f < SUBSETLOWBITS ? f : SUBSETLOWBITS;
+
+    /* weight of every low subset together with the forced vertices */
+    lowweight[0] = 0;
+    lowsize[0] = 0;
+    for (j = 0; j < a; ++j)
+    {
+        half = 1 << j;
+        row = 0;
+        for (i = 0; i < j; ++i)
+            if (g[j] & NTH_NODE(i))
+                row |= 1 << i;
+        base = s * POPCOUNT(g[j] & forced) - k;
+        for (x = 0; x < half; ++x)
+        {
+            lowweight[half + x] = lowweight[x] + s * POPCOUNT(row & x) + base;
+            lowsize[half + x] = lowsize[x] + 1;
+        }
+    }
+
+    /* weight of the forced vertices on their own, including l */
+    size = POPCOUNT(forced);
+    base = l - k * size;
+    for (i = 0; i < MAXN; ++i)
+        if (forced & NTH_NODE(i))
+            base += s * POPCOUNT(g[i] & forced & ~ALLMASK(i + 1));
+
+    mask = forced;
+    cross[0] = 0;
+    for (i = 0;;)
+    {
+        /* edges between the low subsets and the current high subset */
+        for (j = 0; j < a; ++j)
+            degree[j] = s * POPCOUNT(g[j] & mask & ~forced);
+        for (j = 0; j < a; ++j)
+        {
+            half = 1 << j;
+            for (x = 0; x < half; ++x)
+                cross[half + x] = cross[x] + degree[j];
+        }
 
- * See Lee and Streinu (2008) Pebble game algorithms and sparse graphs
+        /* sets on more than N vertices with positive weight violate sparsity */
+        PRUNECOUNT(subsets, 1 << a);
+        limit = N - size;
+        violation = 0;
+        for (x = 0; x < 1 << a; ++x)
+            violation |= (lowsize[x] > limit) & (lowweight[x] + cross[x] + base > 0);
+        if (violation)
+            return TRUE;
+
+        /* next high subset in Gray code order */
+        if (++i >= 1 << f - a)
+            return FALSE;
+        j = a + CTZ(i);
+        mask ^= NTH_NODE(j);
+        if (mask & NTH_NODE(j))
+        {
+            base += s * POPCOUNT(g[j] & mask) - k;
+            size++;
+        }
+        else
+        {
+            base -= s * POPCOUNT(g[j] & mask) - k;
+            size--;
+        }
+    }
+}
+
+/* Maximise s*m(S) - k|S| over all vertex sets S of the graph on n vertices
+ * that contain the vertices in forced. This is the densest subgraph problem
+ * and is solved as a minimum cut, see Goldberg (1984) Finding a maximum
+ * density subgraph. The network has an arc from the source to every vertex v
+ * with capacity s*deg(v), or unbounded capacity if v is forced, an arc from
+ * every vertex to the sink with capacity 2k, and arcs of capacity s in both
+ * directions along every edge. A cut with S on the source side has capacity
+ * 2sm - 2(s*m(S) - k|S|). The maximum flow is found by augmenting along
+ * shortest paths, where the breadth first search expands a whole row of the
+ * residual network at a time.
  *
  * Returns:
- * <0 if the graph is overconstrained
- * 0 if the graph is (k,l)-tight
- * >0 if the graph is (k,l)-sparse
+ * the maximum, and the largest maximising set in *best
  */
-int pebblegame(graph *g, int n, int k, int l)
+long densestsubgraph(graph *g, int n, setword forced, long s, long k, setword *best)
 {
-    int i, j, total, needed;
-    int pebbles[MAXN];
-    setword tovisit, inittovisit;
-    graph d[MAXN] = {0};
+    int i, j, v, m;
+    int parent[MAXN];
+    long flow, srccap[MAXN], sinkcap[MAXN], cap[MAXN][MAXN];
+    setword resid[MAXN];
+    setword visited, frontier, next, found;
 
+    m = 0;
     for (i = 0; i < n; ++i)
-        pebbles[i] = k;
-
+    {
+        resid[i] = g[i] & ALLMASK(n);
+        m += POPCOUNT(resid[i]);
+        srccap[i] = s * POPCOUNT(resid[i]);
+        sinkcap[i] = 2 * k;
+        for (j = 0; j < n; ++j)
+            cap[i][j] = resid[i] & NTH_NODE(j) ? s : 0;
+    }
     for (i = 0; i < n; ++i)
+        if (forced & NTH_NODE(i))
+            srccap[i] = s * m + 2 * k * n + 1; /* exceeds every finite cut */
+
+    for (;;)
     {
-        for (j = 0; j < i; ++j)
+        /* breadth first search from the source in the residual network */
+        visited = 0;
+        for (i = 0; i < n; ++i)
         {
-            if ((g[i] & NTH_NODE(j)) == 0)
-                continue;
-
-            // (i,j) is an edge.
-            needed = l + 1 - pebbles[i] - pebbles[j];
-            inittovisit = ALLMASK(n) & ~NTH_NODE(i) & ~NTH_NODE(j);
-            tovisit = inittovisit;
-            while (needed > 0 && pebbles[i] < k && find_pebble(d, pebbles, n, &tovisit, i))
+            if (srccap[i] > 0)
             {
-                needed--;
-                pebbles[i]++;
-                tovisit = inittovisit;
+                visited |= NTH_NODE(i);
+                parent[i] = -1;
             }
-            tovisit = inittovisit;
-            while (needed > 0 && pebbles[j] < k && find_pebble(d, pebbles, n, &tovisit, j))
+        }
+        v = -1;
+        frontier = visited;
+        while (frontier && v < 0)
+        {
+            next = 0;
+            while (frontier)
             {
-                needed--;
-                pebbles[j]++;
-                tovisit = inittovisit;
+                i = FIRSTBITNZ(frontier);
+                frontier &= ~NTH_NODE(i);
+                if (sinkcap[i] > 0)
+                {
+                    v = i;
+                    break;
+                }
+                found = resid[i] & ~visited;
+                visited |= found;
+                next |= found;
+                while (found)
+                {
+                    j = FIRSTBITNZ(found);
+                    found &= ~NTH_NODE(j);
+                    parent[j] = i;
+                }
             }
-            if (needed > 0)
-                return -1;
+            frontier = next;
+        }
+        if (v < 0)
+            break;
 
-            if (pebbles[i] > pebbles[j])
-            {
-                pebbles[i]--;
-                d[i] |= NTH_NODE(j);
-            }
-            else
-            {
-                pebbles[j]--;
-                d[j] |= NTH_NODE(i);
-            }
+        /* augment along the path found */
+        flow = sinkcap[v];
+        for (j = v; parent[j] >= 0; j = parent[j])
+            if (cap[parent[j]][j] < flow)
+                flow = cap[parent[j]][j];
+        if (srccap[j] < flow)
+            flow = srccap[j];
+
+        sinkcap[v] -= flow;
+        for (j = v; parent[j] >= 0; j = parent[j])
+        {
+            i = parent[j];
+            if ((cap[i][j] -= flow) == 0)
+                resid[i] &= ~NTH_NODE(j);
+            if ((cap[j][i] += flow) == flow)
+                resid[j] |= NTH_NODE(i);
         }
+        srccap[j] -= flow;
     }
 
-    total = 0;
+    /* the vertices that cannot reach the sink form the largest minimum cut */
+    next = 0;
     for (i = 0; i < n; ++i)
-        total += pebbles[i];
-    return total - l;
+        if (sinkcap[i] > 0)
+            next |= NTH_NODE(i);
+    do
+    {
+        found = next;
+        for (i = 0; i < n; ++i)
+            if (resid[i] & found)
+                next |= NTH_NODE(i);
+    } while (next != found);
+    *best = ALLMASK(n) & ~found;
+
+    m = 0;
+    for (i = 0; i < n; ++i)
+        if (*best & NTH_NODE(i))
+            m += POPCOUNT(g[i] & *best);
+    return s * (m / 2) - k * POPCOUNT(*best);
 }
 
-/* dummy function when no pruning is applied */
-int nopruning(graph *g, int n, int maxn)
+/* Determine whether the graph on n vertices has a subgraph on more than N
+ * vertices containing all vertices in forced that violates (k,l)-sparsity,
+ * where the scaled s, sk and sl are given as in scalekl. A single minimum cut
+ * decides the question unless the densest such subgraph has at most N
+ * vertices. In that case, each vertex from first onwards is forced in turn.
+ * The search is cut off as soon as no subgraph containing the forced vertices
+ * violates the condition, so it visits at most the sets of N vertices and is
+ * polynomial for fixed N.
+ *
+ * Returns:
+ * TRUE if there is such a subgraph
+ */
+boolean sparseflowviolation(graph *g, int n, setword forced, int first, long s, long k, long l, int N)
 {
+    int i;
+    setword best;
+
+    PRUNECOUNT(flows, 1);
+    if (densestsubgraph(g, n, forced, s, k, &best) <= -l)
+        return FALSE;
+    if (POPCOUNT(best) > N)
+        return TRUE;
+
+    for (i = first; POPCOUNT(forced | (ALLMASK(n) & ~ALLMASK(i))) > N; ++i)
+        if (!(forced & NTH_NODE(i)) && sparseflowviolation(g, n, forced | NTH_NODE(i), i + 1, s, k, l, N))
+            return TRUE;
     return FALSE;
 }
 
-/* remove graphs that are not (k,l)-sparse
- * seems to have better performance than prunetightgray for k < 2 */
-int prunetightcomb(graph *g, int n, int maxn)
+/* remove graphs that are not (k,l)-sparse using flows at any n, see
+ * sparseflowviolation */
+int prunesparseflow(graph *g, int n, int maxn)
 {
-    int i, k, l, m;
-    int nodeinds[MAXN];
-    int in, out;
-    setword mask;
+    int i, m;
 
     /* small graphs are considered sparse */
     if (n <= minn)
@@ -347,111 +851,282 @@ int prunetightcomb(graph *g, int n, int maxn)
 
     /* subgraph is overdetermined => not sparse */
     if (TOO_MANY_EDGES(n, m))
+    {
+        PRUNECOUNT(edgecheck, 1);
         return TRUE;
+    }
 
-    /* Go through all subgraphs verifying sparsity. geng constructs graphs by
-     * successively adding more nodes. Therefore, we only need to check the
-     * subgraphs containing the new last node. The other subgraphs have been
-     * checked in previous steps. The first subgraph consists of all nodes
-     * except the second to last one. */
-    l = m - POPCOUNT(g[n - 2]);
-    mask = ALLMASK(n) & ~NTH_NODE(n - 2);
-    for (i = 0; i < n - 1; ++i)
-        nodeinds[i] = i;
+    if (!sparseflowviolation(g, n, NTH_NODE(n - 1), 0, scaledmult, scaledk, scaledl, minn))
+        return FALSE;
+    PRUNECOUNT(subsetcheck, 1);
+    return TRUE;
+}
+
+/* Scale (k,l) by the least common multiple s of the denominators. A graph is
+ * (k,l)-sparse if and only if the multigraph where every edge has multiplicity
+ * s is (sk,sl)-sparse. */
+void scalekl(void)
+{
+    long a, b, r;
 
-    /* go through all k-vertex subgraphs */
-    for (k = n - 1; k > minn; --k)
+    a = tightkd;
+    b = tightld;
+    while (b != 0)
     {
-        if (TOO_MANY_EDGES(k, l))
-            return TRUE;
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    scaledmult = tightkd / a * tightld;
+    scaledk = tightkn * (scaledmult / tightkd);
+    scaledl = tightln * (scaledmult / tightld);
+}
 
-        while (nxksrd(n - 1, k - 1, nodeinds, &in, &out))
-        {
-            l -= POPCOUNT(g[out] & mask);
-            mask ^= NTH_NODE(out);
-            mask ^= NTH_NODE(in);
-            l += POPCOUNT(g[in] & mask);
+/* Parse a possibly rational number such as 3/2 given as an argument to
+ * filter_sparse or bench_prune.
+ *
+ * Returns:
+ * TRUE if s is a number
+ */
+boolean parserational(const char *s, long *num, long *den)
+{
+    char *end;
 
-            if (TOO_MANY_EDGES(k, l))
-                return TRUE;
-        }
-        /* nodeinds == 0..k-2, in == k-2, out == n-2 */
-        l -= POPCOUNT(g[out] & mask);
-        mask ^= NTH_NODE(out);
+    *num = strtol(s, &end, 10);
+    *den = 1;
+    if (end == s)
+        return FALSE;
+    if (*end == '/')
+    {
+        s = end + 1;
+        *den = strtol(s, &end, 10);
+        if (end == s || *den == 0)
+            return FALSE;
     }
-    return FALSE;
+    if (*den < 0)
+    {
+        *num = -*num;
+        *den = -*den;
+    }
+    return *end == '\0';
 }
 
-/* remove graphs that are not (k,l)-sparse
- * seems to have better performance than prunetightcomb for k >= 2 */
-int prunetightgray(graph *g, int n, int maxn)
+/* The pebble game decides (sk,sl)-sparsity of the scaled multigraph for
+ * 0 <= sl < 2sk, see scalekl. Subgraphs on at most N vertices are exempt from
+ * the sparsity condition, which makes no difference as long as the complete
+ * graphs on at most N vertices are sparse.
+ *
+ * Returns:
+ * TRUE if the pebble game can be used for the current (k,l,N)
+ */
+boolean setuppebblegame(void)
 {
-    int i, j, m, k, l, degree;
-    setword mask;
+    int t;
 
-    /* small graphs are considered sparse */
-    if (n <= minn)
+    scalekl();
+    if (scaledl < 0 || scaledl >= 2 * scaledk || scaledk > 255) /* see pebblemult */
         return FALSE;
 
-    /* find number of edges */
-    m = 0;
-    for (i = 0; i < n; ++i)
-        m += POPCOUNT(g[i]);
-    m = m / 2;
+    for (t = 2; t <= minn; ++t)
+        if (TOO_MANY_EDGES(t, t * (t - 1) / 2))
+            return FALSE;
+    return TRUE;
+}
 
-    /* subgraph is overdetermined => not sparse */
-    if (TOO_MANY_EDGES(n, m))
-        return TRUE;
+/* Continue the pebble game at depth n from the final state of the parent
+ * graph one level up and add the new vertex n-1 with k free pebbles.
+ *
+ * Returns:
+ * the number of edges in the graph
+ */
+int pebblestate(graph *g, int n)
+{
+    int i, j, m;
 
-    /* Go through all subgraphs verifying sparsity. We use the Gray code binary
-     * representation of i as a mask for which nodes are included in the
-     * subgraph. This way, in every iteration, we either add or remove a single
-     * node to the previous subgraph. */
-    k = 1;
-    l = 0;
-    mask = NTH_NODE(n - 1); /* always include the new node */
-    for (i = 1; i < (1 << n - 1); ++i)
-    {
-        j = CTZ(i);
-        mask ^= NTH_NODE(j); /* add or remove node */
-        degree = POPCOUNT(g[j] & mask);
-        l += mask & NTH_NODE(j) ? degree : -degree;
-        k += mask & NTH_NODE(j) ? 1 : -1;
-
-        if (k > minn && TOO_MANY_EDGES(k, l))
-            return TRUE;
+    /* geng does not prune the single vertex graph */
+    if (n == 2)
+    {
+        pebbleorient[1][0] = 0;
+        pebblecount[1][0] = scaledk;
+        pebbleedges[1] = 0;
+        pebblecomp[1][0] = 0;
     }
-    return FALSE;
+
+    for (i = 0; i < n - 1; ++i)
+    {
+        pebbleorient[n][i] = pebbleorient[n - 1][i];
+        pebblecount[n][i] = pebblecount[n - 1][i];
+    }
+    pebbleorient[n][n - 1] = 0;
+    pebblecount[n][n - 1] = scaledk;
+
+    if (scaledmult > 1)
+    {
+        for (i = 0; i < n - 1; ++i)
+        {
+            for (j = 0; j < n - 1; ++j)
+                pebblemult[n][i][j] = pebblemult[n - 1][i][j];
+            pebblemult[n][i][n - 1] = 0;
+        }
+        for (j = 0; j < n; ++j)
+            pebblemult[n][n - 1][j] = 0;
+    }
+
+    m = pebbleedges[n - 1] + POPCOUNT(g[n - 1]);
+    pebbleedges[n] = m;
+    return m;
 }
 
-/* remove graphs that are not (k,l)-sparse
- * performs much better than the other methods for integer k and l such that 0 <= l < 2k */
-int prunetightpebble(graph *g, int n, int maxn)
+/* Look for a tight subgraph containing i and j after the edge (i,j) has been
+ * played and left exactly l free pebbles on its endpoints. The vertices
+ * reachable from i and j span k|V'|-l edges unless another free pebble can be
+ * reached, in which case the search stops early. A tight subgraph found this
+ * way is added to the component mask of each of its vertices. */
+void pebblecomponent(graph *d, int *pebbles, setword *comp, int n, int i, int j)
 {
-    int i, j, m, k, l, degree;
-    setword mask;
+    int v;
+    setword free, span, frontier, found;
 
-    /* small graphs are considered sparse */
-    if (n <= minn)
-        return FALSE;
+    free = 0;
+    for (v = 0; v < n; ++v)
+        if (pebbles[v] > 0)
+            free |= NTH_NODE(v);
+    free &= ~NTH_NODE(i) & ~NTH_NODE(j);
 
-    /* find number of edges */
-    m = 0;
-    for (i = 0; i < n; ++i)
-        m += POPCOUNT(g[i]);
-    m = m / 2;
+    span = frontier = NTH_NODE(i) | NTH_NODE(j);
+    while (frontier)
+    {
+        v = FIRSTBITNZ(frontier);
+        frontier &= ~NTH_NODE(v);
+        found = d[v] & ~span;
+        if (found & free)
+            return;
+        span |= found;
+        frontier |= found;
+    }
 
-    /* subgraph is overdetermined => not sparse */
-    if (m > tightkn * n - tightln)
-        return TRUE;
+    for (frontier = span; frontier; frontier &= ~NTH_NODE(v))
+    {
+        v = FIRSTBITNZ(frontier);
+        comp[v] |= span;
+    }
+}
+
+/* The generic engines and their instances for the (k,l,N) run most often,
+ * see prunekernel.h. N is the default of PLUGIN_INIT. Bipartite graphs, e.g.,
+ * bipartite Laman graphs, use the instance of their (k,l). */
+#include "prunekernel.h"
+
+#define KERNEL_SUFFIX _k1l0
+#define KERNEL_KN 1
+#define KERNEL_KD 1
+#define KERNEL_LN 0
+#define KERNEL_LD 1
+#define KERNEL_N 3
+#define KERNEL_S 1
+#include "prunekernel.h"
+
+#define KERNEL_SUFFIX _k1l1
+#define KERNEL_KN 1
+#define KERNEL_KD 1
+#define KERNEL_LN 1
+#define KERNEL_LD 1
+#define KERNEL_N 2
+#define KERNEL_S 1
+#include "prunekernel.h"
+
+#define KERNEL_SUFFIX _k2l3
+#define KERNEL_KN 2
+#define KERNEL_KD 1
+#define KERNEL_LN 3
+#define KERNEL_LD 1
+#define KERNEL_N 3
+#define KERNEL_S 1
+#include "prunekernel.h"
+
+#define KERNEL_SUFFIX _k3l6
+#define KERNEL_KN 3
+#define KERNEL_KD 1
+#define KERNEL_LN 6
+#define KERNEL_LD 1
+#define KERNEL_N 4
+#define KERNEL_S 1
+#include "prunekernel.h"
+
+#define KERNEL_SUFFIX _k3_2l2
+#define KERNEL_KN 3
+#define KERNEL_KD 2
+#define KERNEL_LN 2
+#define KERNEL_LD 1
+#define KERNEL_N 2
+#define KERNEL_S 2
+#include "prunekernel.h"
 
-    return pebblegame(g, n, tightkn, tightln) < 0;
+/* The engines of prunekernel.h for one (k,l,N). The generic engines come
+ * first and match any (k,l,N). */
+typedef struct
+{
+    long kn, kd, ln, ld;
+    int n;
+    int (*pebble)(graph *, int, int);
+    int (*pebblecomp)(graph *, int, int);
+    int (*comb)(graph *, int, int);
+    int (*gray)(graph *, int, int);
+    int (*pebblegame)(graph *, int, int, int, int);
+} prunekernel;
+
+static const prunekernel prunekernels[] = {
+    {0, 0, 0, 0, 0, prunetightpebble, prunetightpebblecomp, prunetightcomb, prunetightgray, pebblegame},
+    {1, 1, 0, 1, 3, prunetightpebble_k1l0, prunetightpebblecomp_k1l0, prunetightcomb_k1l0, prunetightgray_k1l0,
+     pebblegame_k1l0},
+    {1, 1, 1, 1, 2, prunetightpebble_k1l1, prunetightpebblecomp_k1l1, prunetightcomb_k1l1, prunetightgray_k1l1,
+     pebblegame_k1l1},
+    {2, 1, 3, 1, 3, prunetightpebble_k2l3, prunetightpebblecomp_k2l3, prunetightcomb_k2l3, prunetightgray_k2l3,
+     pebblegame_k2l3},
+    {3, 1, 6, 1, 4, prunetightpebble_k3l6, prunetightpebblecomp_k3l6, prunetightcomb_k3l6, prunetightgray_k3l6,
+     pebblegame_k3l6},
+    {3, 2, 2, 1, 2, prunetightpebble_k3_2l2, prunetightpebblecomp_k3_2l2, prunetightcomb_k3_2l2,
+     prunetightgray_k3_2l2, pebblegame_k3_2l2},
+};
+
+/* The engines used for the current (k,l,N), see selectkernel. */
+static const prunekernel *kernel = &prunekernels[0];
+
+/* Use the instance of the engines for the current (k,l,N) if there is one,
+ * and the generic engines otherwise. */
+void selectkernel(void)
+{
+    int i;
+
+    kernel = &prunekernels[0];
+    for (i = 1; i < (int)(sizeof(prunekernels) / sizeof(prunekernels[0])); ++i)
+        if (tightkn * prunekernels[i].kd == prunekernels[i].kn * tightkd &&
+            tightln * prunekernels[i].ld == prunekernels[i].ln * tightld && minn == prunekernels[i].n)
+            kernel = &prunekernels[i];
 }
 
-/* remove graphs that cannot be constructed using Henneberg type I moves */
+/* remove graphs that are not (k,l)-sparse
+ * polynomial for fixed N, used when the pebble game does not apply to large n */
+int prunetightflow(graph *g, int n, int maxn)
+{
+    if (n < FLOWMINN)
+        return tightkn < 2 * tightkd ? kernel->comb(g, n, maxn) : kernel->gray(g, n, maxn);
+    return prunesparseflow(g, n, maxn);
+}
+
+/* remove graphs that cannot be constructed using Henneberg type I moves
+ *
+ * Reversing the moves of a construction orders the vertices so that every
+ * vertex has at most k neighbours before it, i.e., the graph is k-degenerate,
+ * and the k(k+1)/2 edges missing from kn then force the first k vertices to
+ * be complete and the rest to have exactly k. Conversely, a k-degenerate
+ * graph with kn-l edges is constructible. Since every subgraph of a
+ * k-degenerate graph is k-degenerate, the graphs below maxn are pruned unless
+ * repeatedly removing vertices of degree at most k removes all of them, which
+ * rejects, e.g., K_{3,3} and every graph containing it for k = 2. */
 int prunehenneberg1(graph *g, int n, int maxn)
 {
-    int i, m;
+    int i, m, degree;
     setword mask, tovisit;
 
     /* small graphs are considered sparse */
@@ -466,24 +1141,875 @@ int prunehenneberg1(graph *g, int n, int maxn)
 
     /* subgraph is overdetermined => not sparse */
     if (m > tightkn * n - tightln)
+    {
+        PRUNECOUNT(edgecheck, 1);
         return TRUE;
+    }
 
-    /* we are done with subgraphs */
-    if (n != maxn)
-        return FALSE;
-
-    /* deconstruct graph by reversing Henneberg type I moves */
+    /* deconstruct graph by reversing Henneberg type I moves, below maxn
+     * also removing the vertices of lower degree */
     mask = ALLMASK(n);
     tovisit = ALLMASK(n);
     while (tovisit)
     {
         i = FIRSTBITNZ(tovisit);
         tovisit &= ~NTH_NODE(i);
-        if (POPCOUNT(g[i] & mask) == tightkn)
+        degree = POPCOUNT(g[i] & mask);
+        if (degree == tightkn || (degree < tightkn && n != maxn))
         {
             tovisit |= g[i] & mask;
             mask &= ~NTH_NODE(i);
         }
     }
-    return POPCOUNT(mask) > tightkn;
+    if (n != maxn ? mask == 0 : POPCOUNT(mask) <= tightkn)
+        return FALSE;
+    PRUNECOUNT(henneberg, 1);
+    return TRUE;
+}
+
+static inline unsigned long long rigidmul(unsigned long long a, unsigned long long b)
+{
+    unsigned __int128 z = (unsigned __int128)a * b;
+    unsigned long long r = ((unsigned long long)z & RIGIDPRIME) + (unsigned long long)(z >> 61);
+    return r >= RIGIDPRIME ? r - RIGIDPRIME : r;
+}
+
+static inline unsigned long long rigidsub(unsigned long long a, unsigned long long b)
+{
+    return a >= b ? a - b : a + RIGIDPRIME - b;
+}
+
+/* a^(p-2) = a^-1 modulo the prime p */
+unsigned long long rigidinv(unsigned long long a)
+{
+    unsigned long long e, r;
+
+    r = 1;
+    for (e = RIGIDPRIME - 2; e; e >>= 1)
+    {
+        if (e & 1)
+            r = rigidmul(r, a);
+        a = rigidmul(a, a);
+    }
+    return r;
+}
+
+/* Fill the coordinates with fixed random numbers modulo the prime 2^61-1
+ * generated from the seed. */
+void randompoints(unsigned long long *point, int count, unsigned long long x)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        point[i] = (x & RIGIDPRIME) % RIGIDPRIME;
+    }
+}
+
+/* Place the vertices at fixed random points modulo the prime 2^61-1 and
+ * allocate the basis of the rigidity matroid. */
+void setuprigidity(int maxn)
+{
+    rigidstride = rigiddim * maxn;
+    rigidpoint = malloc(rigidstride * sizeof(*rigidpoint));
+    rigidrows = malloc((size_t)rigidstride * rigidstride * sizeof(*rigidrows));
+    rigidpivot = malloc(rigidstride * sizeof(*rigidpivot));
+    if (!rigidpoint || !rigidrows || !rigidpivot)
+        gt_abort(">E gensparseg: not enough memory for -R\n");
+    randompoints(rigidpoint, rigidstride, 0x9E3779B97F4A7C15ULL);
+}
+
+/* remove graphs whose edges are dependent in the generic rigidity matroid in
+ * rigiddim dimensions
+ *
+ * The rows of the rigidity matrix for the fixed points of setuprigidity are
+ * reduced modulo 2^61-1 against the basis of the parent graph one at a time.
+ * A graph is rejected when a row of the new vertex reduces to zero.
+ * Independence is inherited by subgraphs, so every descendant would be
+ * rejected as well. A generically independent graph is rejected by mistake
+ * with probability at most dn/(2^61-1) by the Schwartz-Zippel lemma. */
+int prunerigidity(graph *g, int n, int maxn)
+{
+    int i, j, k, c, rank, cols;
+    setword nb;
+    unsigned long long f, *row, *brow;
+
+    cols = rigiddim * n;
+    rank = rigidrank[n - 1];
+    nb = g[n - 1];
+    while (nb)
+    {
+        i = FIRSTBITNZ(nb);
+        nb &= ~NTH_NODE(i);
+
+        row = rigidrows + (size_t)rank * rigidstride;
+        for (j = 0; j < rigidstride; ++j)
+            row[j] = 0;
+        for (j = 0; j < rigiddim; ++j)
+        {
+            f = rigidsub(rigidpoint[rigiddim * (n - 1) + j], rigidpoint[rigiddim * i + j]);
+            row[rigiddim * (n - 1) + j] = f;
+            row[rigiddim * i + j] = rigidsub(0, f);
+        }
+
+        for (k = 0; k < rank; ++k)
+        {
+            c = rigidpivot[k];
+            f = row[c];
+            if (f == 0)
+                continue;
+            brow = rigidrows + (size_t)k * rigidstride;
+            for (j = c; j < cols; ++j)
+                row[j] = rigidsub(row[j], rigidmul(f, brow[j]));
+        }
+
+        for (c = 0; c < cols && row[c] == 0; ++c)
+            ;
+        if (c == cols)
+        {
+            PRUNECOUNT(rigidity, 1);
+            return TRUE;
+        }
+
+        f = rigidinv(row[c]);
+        for (j = c; j < cols; ++j)
+            row[j] = rigidmul(row[j], f);
+        rigidpivot[rank++] = c;
+    }
+    rigidrank[n] = rank;
+    return FALSE;
+}
+
+/* The cycle counter where available, and nanoseconds otherwise. */
+static inline unsigned long long pruneticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+/* Add count graphs with the given degree sequence to the open addressing
+ * table of -G, which is kept at most half full. */
+void addsequence(const unsigned char *degrees, unsigned long long count)
+{
+    size_t i, h, slots;
+    unsigned long long hash;
+    degreesequence *old;
+
+    if (2 * (statsequencecount + 1) > statsequenceslots)
+    {
+        old = statsequences;
+        slots = statsequenceslots;
+        statsequenceslots = slots ? 2 * slots : 1024;
+        statsequences = calloc(statsequenceslots, sizeof(*statsequences));
+        if (statsequences == NULL)
+            gt_abort(">E gensparseg: not enough memory for the statistics\n");
+        statsequencecount = 0;
+        for (i = 0; i < slots; ++i)
+            if (old[i].count)
+                addsequence(old[i].degrees, old[i].count);
+        free(old);
+    }
+
+    hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    for (i = 0; i < MAXN; ++i)
+        hash = (hash ^ degrees[i]) * 0x100000001B3ULL;
+    h = hash & (statsequenceslots - 1);
+    while (statsequences[h].count && memcmp(statsequences[h].degrees, degrees, MAXN) != 0)
+        h = (h + 1) & (statsequenceslots - 1);
+    if (!statsequences[h].count)
+    {
+        memcpy(statsequences[h].degrees, degrees, MAXN);
+        statsequencecount++;
+    }
+    statsequences[h].count += count;
+}
+
+/* Add a generated graph to the histograms of -G. */
+void recordstatistics(graph *g, int n)
+{
+    int i, d, edges, mindegree, maxdegree;
+    int degreecount[MAXN + 1];
+    unsigned char degrees[MAXN];
+
+    memset(degreecount, 0, sizeof(degreecount));
+    edges = 0;
+    for (i = 0; i < n; ++i)
+    {
+        d = POPCOUNT(g[i]);
+        degreecount[d]++;
+        edges += d;
+    }
+    for (mindegree = 0; !degreecount[mindegree]; ++mindegree)
+        ;
+    for (maxdegree = n - 1; !degreecount[maxdegree]; --maxdegree)
+        ;
+
+    memset(degrees, 0, sizeof(degrees));
+    i = 0;
+    for (d = maxdegree; d >= mindegree; --d)
+    {
+        memset(degrees + i, d, degreecount[d]);
+        i += degreecount[d];
+    }
+    addsequence(degrees, 1);
+
+    statgraphs++;
+    statedges[edges / 2]++;
+    statmindegree[mindegree]++;
+    statmaxdegree[maxdegree]++;
+    for (d = 0; d < n; ++d)
+        statdegree[d][degreecount[d]]++;
+}
+
+/* Wraps the engine in outputengine and runs the filters of -O, -V and -G on
+ * the graphs it accepts on maxn vertices, stopping at the first one that
+ * rejects the graph. geng only outputs and counts the graphs accepted by
+ * prune, so the filters act on the rows of the graph before it is written,
+ * and work together with -J and res/mod. */
+int pruneoutput(graph *g, int n, int maxn)
+{
+    int i;
+
+    if ((*outputengine)(g, n, maxn))
+        return TRUE;
+    if (n == maxn)
+        for (i = 0; i < outputfiltercount; ++i)
+            if ((*outputfilters[i])(g, n))
+                return TRUE;
+    return FALSE;
+}
+
+/* remove graphs that are not (k,l)-sparse for -O, choosing the engine for the
+ * whole graph like filter_sparse */
+int filtersparse(graph *g, int n)
+{
+    if (n <= minn)
+        return FALSE;
+    if (outputpebble)
+        return kernel->pebblegame(g, n, scaledk, scaledl, scaledmult) < 0;
+    if (n >= FLOWMINN)
+        return sparseflowviolation(g, n, 0, 0, scaledmult, scaledk, scaledl, minn);
+    return subsetviolation(g, n, 0, scaledmult, scaledk, scaledl, minn);
+}
+
+/* Place the vertices at fixed random points for -V, independent of the ones
+ * of -R, and allocate the basis of filterrank. */
+void setuprankfilter(int maxn)
+{
+    rankstride = rankdim * maxn;
+    rankpoint = malloc(rankstride * sizeof(*rankpoint));
+    rankrows = malloc((size_t)rankstride * rankstride * sizeof(*rankrows));
+    rankpivot = malloc(rankstride * sizeof(*rankpivot));
+    if (!rankpoint || !rankrows || !rankpivot)
+        gt_abort(">E gensparseg: not enough memory for -V\n");
+    randompoints(rankpoint, rankstride, 0xD1B54A32D192ED03ULL);
+}
+
+/* remove graphs whose rigidity matrix in rankdim dimensions does not have the
+ * rank dn - d(d+1)/2 - rankdof, i.e., the graphs filter_rank d rankdof -e
+ * would remove
+ *
+ * The rows of the edges are reduced modulo 2^61-1 one at a time as in
+ * prunerigidity, and the graph is rejected as soon as the rank exceeds the
+ * target or the remaining edges cannot reach it. A rank that is too low is
+ * found with probability at most dn/(2^61-1). */
+int filterrank(graph *g, int n)
+{
+    int i, j, k, c, v, rank, cols, target, remaining;
+    setword nb;
+    unsigned long long f, *row, *brow;
+
+    cols = rankdim * n;
+    target = cols - rankdim * (rankdim + 1) / 2 - rankdof;
+    remaining = 0;
+    for (i = 0; i < n; ++i)
+        remaining += POPCOUNT(g[i]);
+    remaining /= 2;
+    if (target < 0 || remaining < target)
+        return TRUE;
+
+    rank = 0;
+    for (v = 1; v < n; ++v)
+    {
+        nb = g[v] & ALLMASK(v);
+        while (nb)
+        {
+            i = FIRSTBITNZ(nb);
+            nb &= ~NTH_NODE(i);
+            if (rank + remaining-- < target)
+                return TRUE;
+
+            row = rankrows + (size_t)rank * rankstride;
+            for (j = 0; j < cols; ++j)
+                row[j] = 0;
+            for (j = 0; j < rankdim; ++j)
+            {
+                f = rigidsub(rankpoint[rankdim * v + j], rankpoint[rankdim * i + j]);
+                row[rankdim * v + j] = f;
+                row[rankdim * i + j] = rigidsub(0, f);
+            }
+
+            for (k = 0; k < rank; ++k)
+            {
+                c = rankpivot[k];
+                f = row[c];
+                if (f == 0)
+                    continue;
+                brow = rankrows + (size_t)k * rankstride;
+                for (j = c; j < cols; ++j)
+                    row[j] = rigidsub(row[j], rigidmul(f, brow[j]));
+            }
+
+            for (c = 0; c < cols && row[c] == 0; ++c)
+                ;
+            if (c == cols)
+                continue;
+            if (rank == target)
+                return TRUE;
+            f = rigidinv(row[c]);
+            for (j = c; j < cols; ++j)
+                row[j] = rigidmul(row[j], f);
+            rankpivot[rank++] = c;
+        }
+    }
+    return rank != target;
+}
+
+/* Record the graphs for -G. These are the graphs geng outputs, which
+ * printstatistics checks against the count of geng. */
+int filterstatistics(graph *g, int n)
+{
+    recordstatistics(g, n);
+    return FALSE;
+}
+
+int comparesequences(const void *a, const void *b)
+{
+    return memcmp(((const degreesequence *)a)->degrees, ((const degreesequence *)b)->degrees, MAXN);
+}
+
+/* Print the histograms of -G on stdout with one "histogram key count" line
+ * for every nonzero entry. Lines from several runs, e.g., of different
+ * res/mod, can be merged by summing the counts of equal keys, which
+ * readstatistics and merge_statistics do. */
+void printstatistics(unsigned long long nout)
+{
+    int i, d, c;
+    size_t j, k;
+
+    if (nout != statgraphs)
+        fprintf(stderr, ">W gensparseg: the statistics cover %llu of %llu graphs\n", statgraphs, nout);
+
+    printf("graphs %d %llu\n", statn, statgraphs);
+    for (i = 0; i <= MAXN * (MAXN - 1) / 2; ++i)
+        if (statedges[i])
+            printf("edges %d %llu\n", i, statedges[i]);
+    for (d = 0; d <= MAXN; ++d)
+        if (statmindegree[d])
+            printf("mindegree %d %llu\n", d, statmindegree[d]);
+    for (d = 0; d <= MAXN; ++d)
+        if (statmaxdegree[d])
+            printf("maxdegree %d %llu\n", d, statmaxdegree[d]);
+    for (d = 0; d <= MAXN; ++d)
+        for (c = 0; c <= MAXN; ++c)
+            if (statdegree[d][c])
+                printf("degree %d:%d %llu\n", d, c, statdegree[d][c]);
+
+    /* the table is no longer needed after this, so it is sorted in place */
+    k = 0;
+    for (j = 0; j < statsequenceslots; ++j)
+        if (statsequences[j].count)
+            statsequences[k++] = statsequences[j];
+    qsort(statsequences, k, sizeof(*statsequences), comparesequences);
+    for (j = 0; j < k; ++j)
+    {
+        printf("degreesequence ");
+        for (i = 0; i < statn; ++i)
+            printf(i ? ",%d" : "%d", statsequences[j].degrees[i]);
+        printf(" %llu\n", statsequences[j].count);
+    }
+    fflush(stdout);
+}
+
+/* Add the histograms printed by printstatistics in a child process of -J. */
+void readstatistics(FILE *f)
+{
+    char name[32], key[256], *s;
+    unsigned long long count;
+    unsigned char degrees[MAXN];
+    int a, b, i;
+
+    while (fscanf(f, "%31s %255s %llu", name, key, &count) == 3)
+    {
+        a = atoi(key);
+        if (strcmp(name, "graphs") == 0)
+            statgraphs += count;
+        else if (strcmp(name, "edges") == 0 && a >= 0 && a <= MAXN * (MAXN - 1) / 2)
+            statedges[a] += count;
+        else if (strcmp(name, "mindegree") == 0 && a >= 0 && a <= MAXN)
+            statmindegree[a] += count;
+        else if (strcmp(name, "maxdegree") == 0 && a >= 0 && a <= MAXN)
+            statmaxdegree[a] += count;
+        else if (strcmp(name, "degree") == 0 && sscanf(key, "%d:%d", &a, &b) == 2 && a >= 0 && a <= MAXN &&
+                 b >= 0 && b <= MAXN)
+            statdegree[a][b] += count;
+        else if (strcmp(name, "degreesequence") == 0)
+        {
+            memset(degrees, 0, sizeof(degrees));
+            s = key;
+            for (i = 0; i < MAXN && *s; ++i)
+            {
+                degrees[i] = strtol(s, &s, 10);
+                if (*s == ',')
+                    s++;
+            }
+            addsequence(degrees, count);
+        }
+        else
+            gt_abort(">E gensparseg: could not read the statistics of a process\n");
+    }
+}
+
+#ifdef PRUNE_INSTRUMENT
+/* Wraps every call to prune with PRUNE_INSTRUMENT. The engines count the
+ * reason of their rejections and their work at instrumentdepth. */
+int pruneinstrumented(graph *g, int n, int maxn)
+{
+    int rejected;
+    unsigned long long start;
+
+    instrumentdepth = n;
+    start = pruneticks();
+    rejected = (*prune)(g, n, maxn);
+    instrument[n].ticks += pruneticks() - start;
+    instrument[n].calls++;
+    instrument[n].rejected += rejected != 0;
+    return rejected;
+}
+
+/* Print the counters of PRUNE_INSTRUMENT with one >Z line per depth. The
+ * lines of separate runs, e.g., with different res/mod, can be summed with
+ * merge_statistics. */
+void reportinstrument(instrumentlevel *levels)
+{
+    int n;
+    instrumentlevel *c;
+
+    for (n = 0; n <= MAXN; ++n)
+    {
+        c = &levels[n];
+        if (c->calls == 0)
+            continue;
+        fprintf(stderr,
+                ">Z depth %d: calls %llu rejected %llu edgecheck %llu subsetcheck %llu pebblegame %llu "
+                "henneberg %llu rigidity %llu subsets %llu flows %llu searches %llu searchsteps %llu ticks %llu\n",
+                n, c->calls, c->rejected, c->edgecheck, c->subsetcheck, c->pebblegame, c->henneberg, c->rigidity,
+                c->subsets, c->flows, c->searches, c->searchsteps, c->ticks);
+    }
+}
+#endif
+
+/* Split the generation into units of work and generate each unit in a child
+ * process, starting the next unit as soon as a child finishes so that no
+ * process idles while work remains. Every child writes its graphs to its own
+ * temporary file, which the parent copies to stdout in the order of the units
+ * as soon as all earlier units are done. With -G, the histograms of the
+ * children are merged instead, see readstatistics. The children report back
+ * through unitsummaries, see summarizeunit.
+ *
+ * Returns:
+ * the unit to generate in each child process, and -1 in the parent once all
+ * units are done
+ */
+int processpool(int processes, int units, boolean nooutput)
+{
+    int unit, next, flushed, running, status;
+    size_t size;
+    pid_t pid, *pids;
+    boolean *done;
+    FILE **outputs;
+    char buffer[1 << 16];
+
+    unitsummaries = mmap(NULL, units * sizeof(*unitsummaries), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pids = malloc(units * sizeof(*pids));
+    done = calloc(units, sizeof(*done));
+    outputs = calloc(units, sizeof(*outputs));
+    if (unitsummaries == MAP_FAILED || pids == NULL || done == NULL || outputs == NULL)
+        gt_abort(">E gensparseg: could not allocate memory for the processes\n");
+
+    next = 0;
+    flushed = 0;
+    running = 0;
+    while (flushed < units)
+    {
+        while (running < processes && next < units)
+        {
+            if (!nooutput && (outputs[next] = tmpfile()) == NULL)
+                gt_abort(">E gensparseg: could not create a temporary file\n");
+            fflush(stdout); /* or the child would write the buffered output again */
+            fflush(stderr);
+            pid = fork();
+            if (pid < 0)
+                gt_abort(">E gensparseg: could not start a process\n");
+            if (pid == 0)
+            {
+                if (!nooutput && dup2(fileno(outputs[next]), STDOUT_FILENO) < 0)
+                    gt_abort(">E gensparseg: could not redirect the output\n");
+                return next;
+            }
+            pids[next++] = pid;
+            running++;
+        }
+
+        pid = wait(&status);
+        if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            gt_abort(">E gensparseg: a process failed\n");
+        running--;
+        for (unit = 0; pids[unit] != pid; ++unit)
+            ;
+        done[unit] = TRUE;
+
+        /* write the output of the units that are done in order */
+        while (flushed < units && done[flushed])
+        {
+            if (!nooutput)
+            {
+                rewind(outputs[flushed]);
+                if (statistics)
+                    readstatistics(outputs[flushed]);
+                else
+                    while ((size = fread(buffer, 1, sizeof(buffer), outputs[flushed])) > 0)
+                        fwrite(buffer, 1, size, stdout);
+                fclose(outputs[flushed]);
+            }
+            flushed++;
+        }
+    }
+    fflush(stdout);
+    free(pids);
+    free(done);
+    free(outputs);
+    return -1;
+}
+
+/* Record the number of graphs and the time of the unit generated by this
+ * process. With -E, the estimates of the probe are recorded instead, where the
+ * time is scaled by the estimated number of calls to prune. */
+void summarizeunit(unsigned long long nout, double t)
+{
+    int n;
+    unitsummary *summary;
+
+    summary = &unitsummaries[processunit];
+    summary->count = nout;
+    summary->seconds = t;
+#ifdef PRUNE_INSTRUMENT
+    memcpy(summary->instrument, instrument, sizeof(instrument));
+#endif
+    if (probing)
+    {
+        for (n = 0; n <= MAXN; ++n)
+            summary->nodes[n] = samplenodes[n];
+        memcpy(summary->autocost, autocost, sizeof(autocost));
+        if (prunecalls > 0)
+            summary->seconds = t * samplecalls / prunecalls;
+    }
+}
+
+/* Set the average number of children at each level from the probes made for
+ * -I, see reportprogress. */
+void setprogresslevels(int probes, int maxn)
+{
+    int unit, n;
+    double parents, children;
+
+    parents = 1;
+    for (n = 2; n <= maxn; ++n)
+    {
+        children = 0;
+        for (unit = 0; unit < probes; ++unit)
+            children += unitsummaries[unit].nodes[n] / probes;
+        levelaverage[n] = parents > 0 ? children / parents : 0;
+        parents = children;
+    }
+    progressstart = progresslast = time(NULL);
+}
+
+/* Report the total of the units generated with -J. */
+void reportprocesses(int units)
+{
+    int unit;
+    unsigned long long count;
+    double seconds;
+
+    count = 0;
+    seconds = 0;
+    for (unit = 0; unit < units; ++unit)
+    {
+        count += unitsummaries[unit].count;
+        seconds += unitsummaries[unit].seconds;
+    }
+#ifdef PRUNE_INSTRUMENT
+    int n, i;
+    unsigned long long *total, *counters;
+
+    memset(instrument, 0, sizeof(instrument));
+    for (unit = 0; unit < units; ++unit)
+        for (n = 0; n <= MAXN; ++n)
+        {
+            total = (unsigned long long *)&instrument[n];
+            counters = (unsigned long long *)&unitsummaries[unit].instrument[n];
+            for (i = 0; i < (int)(sizeof(instrumentlevel) / sizeof(*total)); ++i)
+                total[i] += counters[i];
+        }
+    reportinstrument(instrument);
+#endif
+    fprintf(stderr, ">Z %llu graphs generated in %3.2f sec\n", count, seconds);
+}
+
+/* Report the mean of the probes made with -E together with the standard error
+ * of the number of graphs on maxn vertices. */
+void reportestimate(int probes, int maxn)
+{
+    int unit, n;
+    double mean, square, seconds;
+
+    for (n = 2; n <= maxn; ++n)
+    {
+        mean = 0;
+        square = 0;
+        for (unit = 0; unit < probes; ++unit)
+        {
+            mean += unitsummaries[unit].nodes[n] / probes;
+            square += unitsummaries[unit].nodes[n] * unitsummaries[unit].nodes[n] / probes;
+        }
+        fprintf(stderr, ">Z about %.4g graphs on %d vertices", mean, n);
+        if (n == maxn && probes > 1)
+            fprintf(stderr, " (standard error %.2g)", sqrt(fmax(square - mean * mean, 0) / (probes - 1)));
+        fprintf(stderr, "\n");
+    }
+
+    seconds = 0;
+    for (unit = 0; unit < probes; ++unit)
+        seconds += unitsummaries[unit].seconds / probes;
+    fprintf(stderr, ">Z about %.3g sec of CPU time, estimated from %d probes\n", seconds, probes);
+}
+
+/* Print the fraction of the search tree done so far and the time left. Every
+ * level of the current path contributes the fraction of its siblings that are
+ * done, relative to the estimated average number of children at that level or
+ * the number of siblings seen, whichever is larger. */
+void reportprogress(int n, int maxn)
+{
+    int i;
+    double done, scale, children, elapsed;
+
+    done = 0;
+    scale = 1;
+    for (i = 2; i <= n; ++i)
+    {
+        children = fmax(levelaverage[i], levelsiblings[i]);
+        done += scale * (levelsiblings[i] - 1) / children;
+        scale /= children;
+    }
+
+    elapsed = difftime(progresslast, progressstart);
+    fprintf(stderr, ">A %.2f%% done, %llu graphs on %d vertices, %.0f sec elapsed", 100 * done,
+            levelchildren[maxn], maxn, elapsed);
+    if (done > 0)
+        fprintf(stderr, ", about %.0f sec left", elapsed * (1 - done) / done);
+    fprintf(stderr, "\n");
+}
+
+/* Wraps the engine in pruneengine for -E and -I. While probing, every graph
+ * accepted by the engine is kept with probability one over the average number
+ * of children at its level so far, making a random probe of the search tree
+ * with about one child per node. Each kept graph is weighted by the inverse
+ * of the probability of its path, which makes the weighted counts unbiased
+ * estimates of the full counts (Knuth 1975, Estimating the efficiency of
+ * backtrack programs). With -I, a progress line is printed every progress
+ * seconds during the actual generation. */
+int prunesampled(graph *g, int n, int maxn)
+{
+    double children, p;
+    time_t now;
+
+    if (n < 2)
+        return (*pruneengine)(g, n, maxn);
+
+    prunecalls++;
+    samplecalls += sampleweight[n - 1];
+    if ((*pruneengine)(g, n, maxn))
+        return TRUE;
+    levelchildren[n]++;
+    if (probing)
+    {
+        children = (double)levelchildren[n] / levelsampled[n - 1];
+        p = children > 1 ? 1 / children : 1;
+        samplerandom ^= samplerandom << 13;
+        samplerandom ^= samplerandom >> 7;
+        samplerandom ^= samplerandom << 17;
+        if ((samplerandom >> 11) * 0x1.0p-53 >= p)
+            return TRUE;
+        sampleweight[n] = sampleweight[n - 1] / p;
+        samplenodes[n] += sampleweight[n];
+    }
+    levelsampled[n]++;
+
+    if (progress > 0 && processunit < 0)
+    {
+        levelsiblings[n]++;
+        levelsiblings[n + 1] = 0;
+        if ((prunecalls & 4095) == 0)
+        {
+            now = time(NULL);
+            if (difftime(now, progresslast) >= progress)
+            {
+                progresslast = now;
+                reportprogress(n, maxn);
+            }
+        }
+    }
+    return FALSE;
+}
+
+/* The engines timed by -A, see setupautoengines. The pebble game continues
+ * from the state of the parent graph, so the pebble engines have to be used at
+ * every depth up to the deepest one they are used at. The other engines only
+ * look at the graph itself. */
+static int (*autocandidates[AUTOENGINES])(graph *, int, int);
+static const char *const autonames[AUTOENGINES] = {"pebble", "pebblecomp", "comb", "gray", "flow"};
+
+/* Time the engines of the kernel selected for (k,l,N) with -A.
+ *
+ * Returns:
+ * TRUE if the pebble game can be used
+ */
+boolean setupautoengines(void)
+{
+    autocandidates[0] = kernel->pebble;
+    autocandidates[1] = kernel->pebblecomp;
+    autocandidates[2] = kernel->comb;
+    autocandidates[3] = kernel->gray;
+    autocandidates[4] = prunesparseflow;
+    return setuppebblegame();
+}
+
+/* Whether engine e of autocandidates is timed at depth n. Going through the
+ * subsets is only feasible below FLOWMINN, and the flows only pay off from
+ * SUBSETMINN. */
+boolean autovalid(int e, int n)
+{
+    if (e <= 1)
+        return autopebble;
+    if (e <= 3)
+        return n < FLOWMINN;
+    return n >= SUBSETMINN;
+}
+
+/* Time every valid engine on the graph during the probes of -A. The time is
+ * weighted by the inverse probability of the probe reaching the graph, which
+ * makes autocost an estimate of the time of each engine for the whole run,
+ * see prunesampled. The engines take turns going first. All of them decide
+ * sparsity exactly, so they agree on the result. */
+int prunecalibrate(graph *g, int n, int maxn)
+{
+    static int first = 0;
+    int i, e, rejected;
+    unsigned long long start;
+
+    rejected = FALSE;
+    first = (first + 1) % AUTOENGINES;
+    for (i = 0; i < AUTOENGINES; ++i)
+    {
+        e = (first + i) % AUTOENGINES;
+        if (!autovalid(e, n))
+            continue;
+        start = pruneticks();
+        rejected = (*autocandidates[e])(g, n, maxn) != 0;
+        autocost[e][n] += sampleweight[n - 1] * (pruneticks() - start);
+    }
+    return rejected;
+}
+
+/* Prune using the engine selected for the depth by -A. */
+int pruneauto(graph *g, int n, int maxn)
+{
+    return (*autoengines[n])(g, n, maxn);
+}
+
+/* Select the engine of every depth for -A from the time of each engine
+ * estimated by the probes. Every depth gets the fastest engine that does not
+ * need the parent state, unless the pebble engines are faster up to some
+ * depth, counting all depths before. */
+void selectautoengines(int probes, int maxn)
+{
+    int unit, e, n, p, depth, prefix, engine[MAXN + 1];
+    double cost[AUTOENGINES][MAXN + 1], total, best;
+
+    memset(cost, 0, sizeof(cost));
+    for (unit = 0; unit < probes; ++unit)
+        for (e = 0; e < AUTOENGINES; ++e)
+            for (n = 0; n <= maxn; ++n)
+                cost[e][n] += unitsummaries[unit].autocost[e][n];
+
+    /* without any time, e.g., at the depths the probes did not reach, use the
+     * engine PLUGIN_INIT would use */
+    for (n = 0; n <= maxn; ++n)
+    {
+        engine[n] = n >= FLOWMINN ? 4 : tightkn < 2 * tightkd ? 2 : 3;
+        for (e = 2; e < AUTOENGINES; ++e)
+            if (autovalid(e, n) && cost[e][n] < cost[engine[n]][n])
+                engine[n] = e;
+    }
+
+    /* the pebble engine p at every depth up to depth */
+    prefix = -1;
+    depth = 0;
+    best = 0;
+    for (p = 0; p <= 1 && autopebble; ++p)
+    {
+        total = 0;
+        for (n = 2; n <= maxn; ++n)
+        {
+            total += cost[p][n] - cost[engine[n]][n];
+            if (total < best)
+            {
+                best = total;
+                prefix = p;
+                depth = n;
+            }
+        }
+    }
+    for (n = 0; n <= maxn; ++n)
+        autoengines[n] = autocandidates[prefix >= 0 && n <= depth ? prefix : engine[n]];
+}
+
+/* Print the engines selected by -A, merging consecutive depths. */
+void reportautoengines(int maxn)
+{
+    int e, n, last;
+
+    fprintf(stderr, ">A -A engines by depth:");
+    for (n = 2; n <= maxn; n = last + 1)
+    {
+        for (last = n; last < maxn && autoengines[last + 1] == autoengines[n]; ++last)
+            ;
+        for (e = 0; autocandidates[e] != autoengines[n]; ++e)
+            ;
+        if (last == n)
+            fprintf(stderr, " %d %s", n, autonames[e]);
+        else
+            fprintf(stderr, " %d-%d %s", n, last, autonames[e]);
+        fprintf(stderr, last < maxn ? "," : "\n");
+    }
 }